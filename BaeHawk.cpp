@@ -2,14 +2,13 @@
 
 namespace game {
 
-	BaeHawk::BaeHawk(const std::string name, const Resource *geometry, const Resource *material, const Resource * tex, SceneNode *meter) : SceneNode(name, geometry, material, tex) {
+	BaeHawk::BaeHawk(const std::string name, const Resource *geometry, const Resource *material, const Resource * tex) : SceneNode(name, geometry, material, tex) {
 		speed = 0.5;
 		radius = 1;
 		draw = true;
 
 		health = 200;
-
-		Affection = meter;
+		terrain = NULL;
 
 	}
 
@@ -34,6 +33,12 @@ namespace game {
 		player = pla;
 	}
 
+
+	void BaeHawk::setTerrain(const Terrain *ground) {
+
+		terrain = ground;
+	}
+
 	void BaeHawk::takeDamage(int damageTaken) {
 
 		health -= damageTaken;
@@ -54,7 +59,11 @@ namespace game {
 		glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0, 0.0, 1.0));
 		this->Rotate(rotation);
 		
-		if (position_.y < -13) position_.y = -13;
+		// Stay above the ground
+		if (terrain) {
+			float ground = terrain->GetHeight(position_.x, position_.z) + 2;
+			if (position_.y < ground) position_.y = ground;
+		}
 
 		
 
@@ -64,10 +73,5 @@ namespace game {
 		draw = newDraw;
 	}
 
-	SceneNode* BaeHawk::getAffection() {
-		return Affection;
-	}
-
-
 } // namespace game
 
@@ -11,6 +11,7 @@
 
 #include "resource.h"
 #include "scene_node.h"
+#include "terrain.h"
 #include "Player.h"
 
 namespace game {
@@ -20,7 +21,7 @@ namespace game {
 
 	public:
 		// Create asteroid from given resources
-		BaeHawk(const std::string name, const Resource *geometry, const Resource *material, const Resource *tex, SceneNode *meter);
+		BaeHawk(const std::string name, const Resource *geometry, const Resource *material, const Resource *tex);
 
 		// Destructor
 		~BaeHawk();
@@ -43,7 +44,8 @@ namespace game {
 
 		void setPlayer(Player *pla);
 
-		SceneNode* getAffection();
+		// Ground the plane cannot go below
+		void setTerrain(const Terrain *ground);
 
 
 	private:
@@ -54,7 +56,7 @@ namespace game {
 
 		Player *player;
 
-		SceneNode *Affection;
+		const Terrain *terrain;
 
 	}; // class Asteroid
 
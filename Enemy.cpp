@@ -12,6 +12,7 @@ namespace game {
 		shooting = false;
 		inRange = false;
 		Target = NULL;
+		terrain = NULL;
 	}
 
 
@@ -67,7 +68,11 @@ namespace game {
 
 		position_.y -= 0.3;
 
-		if (position_.y < -13) position_.y = -13;
+		// Stay above the ground
+		if (terrain) {
+			float ground = terrain->GetHeight(position_.x, position_.z) + 2;
+			if (position_.y < ground) position_.y = ground;
+		}
 
 
 	}
@@ -77,6 +82,11 @@ namespace game {
 		Target = target;
 	}
 
+	void Enemy::setTerrain(const Terrain *ground) {
+		terrain = ground;
+	}
+
+
 	SceneNode* Enemy::getTarget(void) {
 		return Target;
 	}
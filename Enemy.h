@@ -12,6 +12,7 @@
 #include "resource.h"
 #include "player.h"
 #include "scene_node.h"
+#include "terrain.h"
 
 namespace game {
 
@@ -46,6 +47,9 @@ namespace game {
 		void setTarget(SceneNode* target);
 		SceneNode* getTarget(void);
 
+		// Ground the enemy cannot go below
+		void setTerrain(const Terrain *ground);
+
 		int getHealth();
 
 		void takeDamage(int);
@@ -64,6 +68,7 @@ namespace game {
 		bool shooting;
 		bool inRange;
 		glm::vec3 patrolPoint;
+		const Terrain *terrain;
 
 
 
@@ -58,7 +58,11 @@ namespace game {
 		glm::vec3 h_diff = Target->GetPosition() - this->GetPosition();
 		position_.y += h_diff.y;
 
-		if (position_.y < -13) position_.y = -13;
+		// Stay above the ground
+		if (terrain) {
+			float ground = terrain->GetHeight(position_.x, position_.z) + 2;
+			if (position_.y < ground) position_.y = ground;
+		}
 
 
 	}
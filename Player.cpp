@@ -9,6 +9,7 @@ namespace game {
 
 		safe = false;
 		health = 200;
+		terrain = NULL;
 
 	}
 
@@ -43,7 +44,11 @@ namespace game {
 	void Player::Update(void) {
 
 		
-		if (position_.y < -13) position_.y = -13;
+		// Stay above the ground
+		if (terrain) {
+			float ground = terrain->GetHeight(position_.x, position_.z) + 2;
+			if (position_.y < ground) position_.y = ground;
+		}
 
 
 	}
@@ -52,6 +57,10 @@ namespace game {
 		draw = newDraw;
 	}
 
+	void Player::setTerrain(const Terrain *ground) {
+		terrain = ground;
+	}
+
 	
 
 
@@ -11,6 +11,7 @@
 
 #include "resource.h"
 #include "scene_node.h"
+#include "terrain.h"
 
 namespace game {
 
@@ -39,6 +40,9 @@ namespace game {
 		void takeDamage(int);
 
 		void setDraw(bool);
+
+		// Ground the player cannot go below
+		void setTerrain(const Terrain *ground);
 		
 
 
@@ -48,6 +52,8 @@ namespace game {
 
 		float health;
 
+		const Terrain *terrain;
+
 	}; // class Asteroid
 
 } // namespace game
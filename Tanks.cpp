@@ -61,7 +61,11 @@ namespace game {
 
 		position_.y -= 0.3;
 
-		if (position_.y < -13) position_.y = -13;
+		// Stay above the ground
+		if (terrain) {
+			float ground = terrain->GetHeight(position_.x, position_.z) + 2;
+			if (position_.y < ground) position_.y = ground;
+		}
 
 
 	}
@@ -1 +1,3 @@
 #define MATERIAL_DIRECTORY "C:/Users/briancunningham3/Desktop/LoghansAdventureofLove"
+#define TEXTURE_CACHE_DIRECTORY "C:/Users/briancunningham3/Desktop/LoghansAdventureofLove/bin/texture_cache"
+#define PROGRAM_CACHE_DIRECTORY "C:/Users/briancunningham3/Desktop/LoghansAdventureofLove/bin/program_cache"
@@ -4,12 +4,18 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <limits>
 
 #include "camera.h"
 
 namespace game {
 
 Camera::Camera(void){
+
+    near_clip_ = 0.01f;
+    far_clip_ = 1000.0f;
+    viewport_width_ = 800.0f;
+    viewport_height_ = 600.0f;
 }
 
 
@@ -115,21 +121,102 @@ void Camera::SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GL
     float top = tan((fov/2.0)*(glm::pi<float>()/180.0))*near;
     float right = top * w/h;
     projection_matrix_ = glm::frustum(-right, right, -top, top, near, far);
+    near_clip_ = near;
+    far_clip_ = far;
+    viewport_width_ = w;
+    viewport_height_ = h;
+}
+
+
+GLfloat Camera::GetNearClip(void) const {
+
+    return near_clip_;
 }
 
 
-void Camera::SetupShader(GLuint program){
+GLfloat Camera::GetFarClip(void) const {
+
+    return far_clip_;
+}
+
+
+glm::mat4 Camera::GetViewMatrix(void){
 
     // Update view matrix
     SetupViewMatrix();
 
-    // Set view matrix in shader
-    GLint view_mat = glGetUniformLocation(program, "view_mat");
-    glUniformMatrix4fv(view_mat, 1, GL_FALSE, glm::value_ptr(view_matrix_));
-    
-    // Set projection matrix in shader
-    GLint projection_mat = glGetUniformLocation(program, "projection_mat");
-    glUniformMatrix4fv(projection_mat, 1, GL_FALSE, glm::value_ptr(projection_matrix_));
+    return view_matrix_;
+}
+
+
+glm::mat4 Camera::GetProjectionMatrix(void) const {
+
+    return projection_matrix_;
+}
+
+
+float Camera::GetScreenSize(glm::vec3 center, float radius) const {
+
+    // The projection scales y by cot(fov/2), which maps the height of the
+    // viewport at unit distance to 2
+    float distance = glm::length(center - position_);
+    if (distance <= radius){
+        return std::numeric_limits<float>::max();
+    }
+    return radius / distance * projection_matrix_[1][1] * viewport_height_;
+}
+
+
+GLfloat Camera::GetViewportWidth(void) const {
+
+    return viewport_width_;
+}
+
+
+GLfloat Camera::GetViewportHeight(void) const {
+
+    return viewport_height_;
+}
+
+
+bool Camera::GetScreenPosition(glm::vec3 point, glm::vec2 &position) const {
+
+    // Coordinates of the point in the camera coordinate system, as in
+    // SetupViewMatrix; the camera looks down its -forward axis
+    glm::vec3 current_forward = orientation_ * forward_;
+    glm::vec3 current_side = orientation_ * side_;
+    glm::vec3 current_up = glm::normalize(glm::cross(current_forward, current_side));
+    glm::vec3 offset = point - position_;
+    float depth = -glm::dot(offset, current_forward);
+    if (depth <= near_clip_){
+        return false;
+    }
+
+    // Perspective division, then from [-1, 1] to pixels
+    float x = glm::dot(offset, current_side) * projection_matrix_[0][0] / depth;
+    float y = glm::dot(offset, current_up) * projection_matrix_[1][1] / depth;
+    position = glm::vec2((x*0.5f + 0.5f) * viewport_width_, (y*0.5f + 0.5f) * viewport_height_);
+    return true;
+}
+
+
+void Camera::GetFrustumPlanes(glm::vec4 planes[6]){
+
+    // Extract the planes from the rows of the view-projection matrix
+    // (Gribb and Hartmann), since a point is inside the view volume when
+    // -w <= x, y, z <= w in clip coordinates
+    glm::mat4 m = glm::transpose(projection_matrix_ * GetViewMatrix());
+
+    planes[0] = m[3] + m[0]; // Left
+    planes[1] = m[3] - m[0]; // Right
+    planes[2] = m[3] + m[1]; // Bottom
+    planes[3] = m[3] - m[1]; // Top
+    planes[4] = m[3] + m[2]; // Near
+    planes[5] = m[3] - m[2]; // Far
+
+    for (int i = 0; i < 6; i++){
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
 }
 
 
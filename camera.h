@@ -45,8 +45,28 @@ namespace game {
             // Set projection from frustum parameters: field-of-view,
             // near and far planes, and width and height of viewport
             void SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h);
-            // Set all camera-related variables in shader program
-            void SetupShader(GLuint program);
+            // Get clipping distances of the projection
+            GLfloat GetNearClip(void) const;
+            GLfloat GetFarClip(void) const;
+            // Get the view matrix for the current camera parameters
+            glm::mat4 GetViewMatrix(void);
+            // Get the projection matrix
+            glm::mat4 GetProjectionMatrix(void) const;
+            // Get the six planes bounding the view volume, in world
+            // coordinates: left, right, bottom, top, near, far
+            // Each plane (a, b, c, d) is normalized and points inwards, so
+            // that a*x + b*y + c*z + d is the signed distance of a point
+            void GetFrustumPlanes(glm::vec4 planes[6]);
+            // Get the approximate diameter, in pixels, of a sphere seen
+            // by the camera
+            float GetScreenSize(glm::vec3 center, float radius) const;
+            // Get the size of the viewport, in pixels
+            GLfloat GetViewportWidth(void) const;
+            GLfloat GetViewportHeight(void) const;
+            // Get the position of a point on the screen, in pixels from the
+            // lower-left corner of the viewport
+            // Returns false if the point is not in front of the camera
+            bool GetScreenPosition(glm::vec3 point, glm::vec2 &position) const;
 
         private:
             glm::vec3 position_; // Position of camera
@@ -55,6 +75,10 @@ namespace game {
             glm::vec3 side_; // Initial side vector
             glm::mat4 view_matrix_; // View matrix
             glm::mat4 projection_matrix_; // Projection matrix
+            GLfloat near_clip_; // Clipping distances of the projection
+            GLfloat far_clip_;
+            GLfloat viewport_width_; // Size of the viewport, in pixels
+            GLfloat viewport_height_;
 
             // Create view matrix from current camera parameters
             void SetupViewMatrix(void);
@@ -0,0 +1,219 @@
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "dynamic_resolution.h"
+
+namespace game {
+
+// Frames measured before the result of the oldest one is read; drivers
+// rarely run more than two or three frames behind
+const size_t frames_in_flight_g = 4;
+
+// Smallest fraction of the output size the scene is drawn at
+const float min_scale_g = 0.5f;
+
+// The scale only grows while the scene takes less than this share of
+// the budget, so that it does not go back and forth around the budget
+const float headroom_g = 0.85f;
+
+// Largest growth of the scale per measure; it shrinks at once, but grows
+// back a little at a time
+const float scale_step_g = 0.05f;
+
+
+DynamicResolution::DynamicResolution(void){
+
+    supported_ = false;
+    output_ = 0;
+    framebuffer_ = 0;
+    color_buffer_ = 0;
+    depth_buffer_ = 0;
+    width_ = 0;
+    height_ = 0;
+    budget_ = 0.0f;
+    scale_ = 1.0f;
+    current_ = 0;
+    measuring_ = false;
+}
+
+
+DynamicResolution::~DynamicResolution(){
+}
+
+
+void DynamicResolution::Init(int width, int height, GLuint framebuffer){
+
+    if ((width <= 0) || (height <= 0)){
+        throw(std::invalid_argument(std::string("Invalid size for the scene target")));
+    }
+    width_ = width;
+    height_ = height;
+    output_ = framebuffer;
+
+    supported_ = GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+    if (!supported_){
+        return;
+    }
+    measures_.resize(frames_in_flight_g);
+    for (size_t i = 0; i < measures_.size(); i++){
+        glGenQueries(1, &measures_[i].query);
+        measures_[i].scale = 1.0f;
+        measures_[i].pending = false;
+    }
+    CreateTarget();
+}
+
+
+void DynamicResolution::Resize(int width, int height){
+
+    // Nothing to draw into while the window is minimized
+    if ((width <= 0) || (height <= 0)){
+        return;
+    }
+    width_ = width;
+    height_ = height;
+    if (supported_){
+        FreeTarget();
+        CreateTarget();
+    }
+}
+
+
+void DynamicResolution::SetBudget(float budget){
+
+    budget_ = budget;
+    if (budget_ <= 0.0f){
+        scale_ = 1.0f;
+    }
+}
+
+
+void DynamicResolution::CreateTarget(void){
+
+    glGenRenderbuffers(1, &color_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, output_);
+    if (status != GL_FRAMEBUFFER_COMPLETE){
+        throw(std::runtime_error(std::string("Incomplete scene framebuffer")));
+    }
+}
+
+
+void DynamicResolution::FreeTarget(void){
+
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteRenderbuffers(1, &color_buffer_);
+    glDeleteRenderbuffers(1, &depth_buffer_);
+    framebuffer_ = 0;
+    color_buffer_ = 0;
+    depth_buffer_ = 0;
+}
+
+
+int DynamicResolution::GetScaledWidth(void) const {
+
+    return std::max((int) (width_*scale_ + 0.5f), 1);
+}
+
+
+int DynamicResolution::GetScaledHeight(void) const {
+
+    return std::max((int) (height_*scale_ + 0.5f), 1);
+}
+
+
+float DynamicResolution::GetScale(void) const {
+
+    return scale_;
+}
+
+
+void DynamicResolution::Begin(void){
+
+    if (!supported_ || (budget_ <= 0.0f)){
+        return;
+    }
+
+    // Reuse the slot of the oldest frame; if the GPU is still not done
+    // with it, this frame goes unmeasured
+    current_ = (current_ + 1) % measures_.size();
+    Measure &measure = measures_[current_];
+    ReadMeasure(measure);
+    measuring_ = !measure.pending;
+    if (measuring_){
+        measure.scale = scale_;
+        measure.pending = true;
+        glBeginQuery(GL_TIME_ELAPSED, measure.query);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, GetScaledWidth(), GetScaledHeight());
+}
+
+
+void DynamicResolution::End(void){
+
+    if (!supported_ || (budget_ <= 0.0f)){
+        return;
+    }
+    if (measuring_){
+        glEndQuery(GL_TIME_ELAPSED);
+        measuring_ = false;
+    }
+
+    // Filter only when stretching
+    int width = GetScaledWidth();
+    int height = GetScaledHeight();
+    GLenum filter = ((width == width_) && (height == height_)) ? GL_NEAREST : GL_LINEAR;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output_);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, filter);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, output_);
+    glViewport(0, 0, width_, height_);
+}
+
+
+void DynamicResolution::ReadMeasure(Measure &measure){
+
+    if (!measure.pending){
+        return;
+    }
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(measure.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available){
+        return;
+    }
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(measure.query, GL_QUERY_RESULT, &elapsed);
+    measure.pending = false;
+    float ms = (float) (elapsed / 1.0e6);
+    if (ms <= 0.0f){
+        return;
+    }
+
+    // The time goes with the number of pixels, i.e. the square of the
+    // scale the frame was drawn at
+    float target = measure.scale * std::sqrt(budget_ / ms);
+    if (ms > budget_){
+        scale_ = std::min(scale_, target);
+    } else if (ms < headroom_g*budget_){
+        scale_ = std::max(scale_, std::min(target, scale_ + scale_step_g));
+    }
+    scale_ = std::min(std::max(scale_, min_scale_g), 1.0f);
+}
+
+} // namespace game
@@ -0,0 +1,80 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace game {
+
+    // Offscreen target for the 3D scene, whose resolution follows the GPU
+    // time of the scene: it shrinks when a frame goes over the budget and
+    // grows back once there is room again
+    // The target is allocated at the full size of the output and drawn
+    // into through a smaller viewport, so that changing the scale never
+    // reallocates it; the result is stretched over the output, where the
+    // HUD is then drawn at full resolution
+    // The time is measured with queries read a few frames later, so that
+    // measuring never waits for the GPU; without timer queries, the scene
+    // is drawn straight into the output
+    class DynamicResolution {
+
+        public:
+            DynamicResolution(void);
+            ~DynamicResolution();
+
+            // Create the target for an output of the given size; the scene
+            // ends up in 'framebuffer' (0 for the window)
+            void Init(int width, int height, GLuint framebuffer);
+            // Follow a change of size of the output
+            void Resize(int width, int height);
+
+            // GPU time allowed to the scene in each frame, in milliseconds;
+            // 0 keeps the full resolution
+            void SetBudget(float budget);
+
+            // Draw into the target, through a viewport of the current scale
+            void Begin(void);
+            // Stretch the target over the output, and give the full
+            // viewport back to what follows
+            void End(void);
+
+            // Fraction of the output size the scene is drawn at
+            float GetScale(void) const;
+
+        private:
+            // Measure of the scene in a frame
+            struct Measure {
+                GLuint query; // Time elapsed query
+                float scale; // Scale the scene was drawn at
+                bool pending; // Whether the result was not read yet
+            };
+
+            // Create and delete the target at the current output size
+            void CreateTarget(void);
+            void FreeTarget(void);
+            // Size of the viewport at the current scale, in pixels
+            int GetScaledWidth(void) const;
+            int GetScaledHeight(void) const;
+            // Read the time of a frame if it is there, and move the scale
+            // towards the one fitting the budget
+            void ReadMeasure(Measure &measure);
+
+            bool supported_; // Whether the driver has timer queries
+            GLuint output_; // Framebuffer receiving the scene
+            GLuint framebuffer_; // Target, and its renderbuffers
+            GLuint color_buffer_;
+            GLuint depth_buffer_;
+            int width_, height_; // Size of the output
+            float budget_;
+            float scale_;
+            std::vector<Measure> measures_; // Ring of frames in flight
+            size_t current_; // Frame being measured
+            bool measuring_; // Whether a query is running
+
+    }; // class DynamicResolution
+
+} // namespace game
+
+#endif // DYNAMIC_RESOLUTION_H_
@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "frame_uniforms.h"
+
+namespace game {
+
+FrameUniforms::FrameUniforms(void){
+
+    alignment_ = 0;
+}
+
+
+FrameUniforms::~FrameUniforms(){
+}
+
+
+void FrameUniforms::Update(Camera *camera, glm::vec3 light_position, float time, StreamBuffer *stream){
+
+    // Query the alignment once an OpenGL context is available
+    if (!alignment_){
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment_);
+        alignment_ = std::max(alignment_, (GLint) 1);
+    }
+
+    FrameBlock block;
+    block.view_mat = camera->GetViewMatrix();
+    block.projection_mat = camera->GetProjectionMatrix();
+    block.view_projection_mat = block.projection_mat * block.view_mat;
+    block.light_position = glm::vec4(light_position, 1.0);
+    block.timer = time;
+    block.padding[0] = block.padding[1] = block.padding[2] = 0.0;
+
+    GLintptr offset = stream->Upload(&block, sizeof(FrameBlock), alignment_);
+    glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, stream->GetBuffer(), offset, sizeof(FrameBlock));
+}
+
+} // namespace game
@@ -0,0 +1,50 @@
+#ifndef FRAME_UNIFORMS_H_
+#define FRAME_UNIFORMS_H_
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "resource.h"
+#include "camera.h"
+#include "stream_buffer.h"
+
+namespace game {
+
+    // Contents of the FrameBlock uniform block of the shader programs
+    // The layout follows the std140 rules: keep it in sync with the GLSL
+    // declaration
+    struct FrameBlock {
+        glm::mat4 view_mat;
+        glm::mat4 projection_mat;
+        glm::mat4 view_projection_mat;
+        glm::vec4 light_position; // World position of the light (w unused)
+        GLfloat timer; // Time of the frame, in seconds
+        GLfloat padding[3];
+    };
+
+    // Values shared by all draws of a frame, in a range of the stream
+    // buffer bound as uniform buffer
+    // They are uploaded and bound once per frame instead of being set in
+    // every program for every node
+    class FrameUniforms {
+
+        public:
+            FrameUniforms(void);
+            ~FrameUniforms();
+
+            // Upload the parameters of the frame to 'stream' and bind them
+            // to the FrameBlock binding point
+            void Update(Camera *camera, glm::vec3 light_position, float time, StreamBuffer *stream);
+
+        private:
+            GLint alignment_; // Alignment of uniform buffer ranges (0 until queried)
+
+    }; // class FrameUniforms
+
+} // namespace game
+
+#endif // FRAME_UNIFORMS_H_
@@ -4,6 +4,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <random>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <stack>
 
 #include "game.h"
 #include "bin/path_config.h"
@@ -30,6 +33,29 @@ namespace game {
 
 	// Materials 
 	const std::string material_directory_g = MATERIAL_DIRECTORY;
+	const int skin_layer_size_g = 512; // Size of the layers of the world texture array
+
+	// HUD layout, in fractions of the viewport height
+	const float hud_health_width_g = 0.0028; // Width of the health bar per health point
+	const float hud_health_y_g = 0.05; // Bottom of the health bar
+	const float hud_bar_height_g = 0.045;
+	const float hud_reticle_size_g = 0.008;
+	const glm::vec2 hud_dialogue_size_g(0.57, 0.23);
+	const float hud_dialogue_y_g = 0.87; // Center of the dialogue panel
+	const glm::vec4 hud_health_color_g(0.2, 0.8, 0.2, 1.0);
+	const glm::vec4 hud_affection_color_g(1.0, 0.4, 0.7, 1.0);
+	const glm::vec4 hud_reticle_color_g(1.0, 1.0, 1.0, 1.0);
+
+	// GPU time of the scene in each frame, in milliseconds, when drawing
+	// into a window: what is left of a 60 Hz frame goes to the HUD and
+	// the swap
+	// Headless runs keep the full resolution unless asked, so that their
+	// images can be compared
+	const float frame_budget_g = 14.0;
+
+	// Enemies alive at once; faraway ones are drawn as impostors, so the
+	// limit is mostly set by the game logic
+	const int max_enemies_g = 150;
 
 
 
@@ -40,12 +66,35 @@ namespace game {
 	}
 
 
-	void Game::Init(void) {
+	void Game::Init(const GameOptions &options) {
 
 		// Run all initialization steps
-		InitWindow();
+		options_ = options;
+		window_ = NULL;
+		frame_count_ = 0;
+		if (options_.headless) {
+			InitHeadless();
+		}
+		else {
+			InitWindow();
+		}
 		InitView();
-		InitEventHandlers();
+		if (window_) {
+			InitEventHandlers();
+		}
+
+		// Per-frame data of the scene and the HUD goes through one ring of
+		// buffers
+		stream_.Init();
+		scene_.SetStreamBuffer(&stream_);
+
+		// Time the passes of the scene along with the rest of the frame
+		scene_.SetProfiler(&profiler_);
+#ifdef GPU_PROFILER
+		if (!options_.profile_log.empty()) {
+			profiler_.SetLogFile(options_.profile_log);
+		}
+#endif
 
 
 		gameState = 0;
@@ -68,12 +117,19 @@ namespace game {
 
 		currentDialogue = 0;
 
+		DialogueTexture = NULL;
+		Flame = NULL;
+
 		// Set variables
 		animating_ = true;
 		paused = false;
 
-		glfwGetCursorPos(window_, &CursorXPos, &CursorYPos);
-		glfwGetCursorPos(window_, &OldCursorXPos, &OldCursorYPos);
+		CursorXPos = CursorYPos = 0.0;
+		if (window_) {
+			glfwGetCursorPos(window_, &CursorXPos, &CursorYPos);
+		}
+		OldCursorXPos = CursorXPos;
+		OldCursorYPos = CursorYPos;
 		a_input = false;
 		s_input = false;
 		d_input = false;
@@ -117,6 +173,29 @@ namespace game {
 	}
 
 
+	void Game::InitHeadless(void) {
+
+		// Create an OpenGL context without any window
+		headless_.Init();
+
+		// GLEW looks for a GLX display once the OpenGL functions are loaded,
+		// and there is none here
+		glewExperimental = GL_TRUE;
+		GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+		if (err == GLEW_ERROR_NO_GLX_DISPLAY) {
+			err = GLEW_OK;
+		}
+#endif
+		if (err != GLEW_OK) {
+			throw(GameException(std::string("Could not initialize the GLEW library: ") + std::string((const char *)glewGetErrorString(err))));
+		}
+
+		// Draw into a framebuffer of the requested size instead
+		headless_.InitFramebuffer(options_.width, options_.height);
+	}
+
+
 	void Game::InitView(void) {
 
 		// Set up z-buffer
@@ -125,9 +204,23 @@ namespace game {
 
 		// Set viewport
 		int width, height;
-		glfwGetFramebufferSize(window_, &width, &height);
+		if (window_) {
+			glfwGetFramebufferSize(window_, &width, &height);
+		}
+		else {
+			width = headless_.GetWidth();
+			height = headless_.GetHeight();
+		}
 		glViewport(0, 0, width, height);
 
+		// Draw the scene offscreen, at a resolution fitting the budget
+		resolution_.Init(width, height, window_ ? 0 : headless_.GetFramebuffer());
+		float budget = options_.frame_budget;
+		if (budget < 0.0f) {
+			budget = window_ ? frame_budget_g : 0.0f;
+		}
+		resolution_.SetBudget(budget);
+
 		// Set up camera
 		// Set current view
 		camera_.SetView(camera_position_g, camera_look_at_g, camera_up_g);
@@ -154,113 +247,91 @@ namespace game {
 
 	void Game::SetupResources(void) {
 
+		// Keep the compressed textures and linked programs between runs
+		resman_.SetTextureCacheDirectory(TEXTURE_CACHE_DIRECTORY);
+		resman_.SetProgramCacheDirectory(PROGRAM_CACHE_DIRECTORY);
+
+		// Pack the vertices of all meshes; the materials of the game do
+		// not read the vertex color, so it is left out
+		if (PackedVertexFormatsSupported()) {
+			resman_.SetVertexFormat(GetVertexLayout<CompactVertexFormat>());
+		}
+
 		// Create a sphere
 		resman_.CreateSphere("SphereMesh");
 		resman_.CreateTorus("TorusMesh");
 		resman_.CreateCube("CubeMesh");
 		resman_.CreateGround("GroundMesh");
 		resman_.CreateParts("PartsMesh");
-		resman_.CreateSphereParticles("SphereParticles");
 
 		// Load material to be applied to sphere
 		std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/shiny_texture");
 		resman_.LoadResource(Material, "ShinyTextureMaterial", filename.c_str());
 
+		// Load materials simulating and drawing the particles
+		std::vector<std::string> particle_outputs;
+		particle_outputs.push_back("position_out");
+		particle_outputs.push_back("velocity_out");
+		particle_outputs.push_back("color_out");
+		particle_outputs.push_back("uv_out");
+		filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle_update");
+		resman_.LoadFeedbackMaterial("ParticleUpdateMaterial", filename.c_str(), particle_outputs);
+		filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle");
+		resman_.LoadResource(Material, "ParticleMaterial", filename.c_str());
+
+		// Load material drawing the HUD
+		filename = std::string(MATERIAL_DIRECTORY) + std::string("/overlay");
+		resman_.LoadResource(Material, "OverlayMaterial", filename.c_str());
+
+		// Load material drawing faraway enemies as pictures
+		filename = std::string(MATERIAL_DIRECTORY) + std::string("/impostor");
+		resman_.LoadResource(Material, "ImpostorMaterial", filename.c_str());
+
+		// Load material drawing the vehicles baked into single meshes
+		filename = std::string(MATERIAL_DIRECTORY) + std::string("/prefab");
+		resman_.LoadResource(Material, "PrefabMaterial", filename.c_str());
+
+
+
+		// Textures of the world objects share one array, so that nodes with
+		// different skins are drawn together; images of other sizes are
+		// resampled to the size of the layers
+		const char *skins[][2] = {
+			{"Flame", "fire.jpg"}, {"LOghan", "LOghan.jpg"}, {"BOrdy", "BOrdy.jpg"},
+			{"Grass", "grass.jpg"}, {"camo", "camo.jpg"}, {"dkmetal", "dkmetal.jpg"},
+			{"metal", "metal.jpg"}, {"catCamo", "catCamo.png"}, {"wall", "wall.png"},
+			{"pcamo", "pcamo.png"}
+		};
+		std::vector<std::string> names, filenames;
+		for (size_t i = 0; i < sizeof(skins) / sizeof(skins[0]); i++) {
+			names.push_back(skins[i][0]);
+			filenames.push_back(std::string(MATERIAL_DIRECTORY) + std::string("/Textures/") + std::string(skins[i][1]));
+		}
+		resman_.LoadTextureArray(names, filenames, skin_layer_size_g, skin_layer_size_g);
+
+		// Dialogue Textures: full-screen panels, then the conversation,
+		// each set in an array at the size of its images
+		names.clear();
+		filenames.clear();
+		const char *panels[] = {"helicopterfuel", "meltheart", "startscreen"};
+		for (size_t i = 0; i < sizeof(panels) / sizeof(panels[0]); i++) {
+			names.push_back(panels[i]);
+			filenames.push_back(std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/") + std::string(panels[i]) + std::string(".jpg"));
+		}
+		resman_.LoadTextureArray(names, filenames);
 
+		names.clear();
+		filenames.clear();
+		for (int i = 1; i <= 11; i++) {
+			std::stringstream ss;
+			ss << "dia" << i;
+			names.push_back(ss.str());
+			filenames.push_back(std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/") + ss.str() + std::string(".png"));
+		}
+		resman_.LoadTextureArray(names, filenames);
 
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/fire.jpg");
-		resman_.LoadResource(Texture, "Flame", filename.c_str());
-
-		// Load texture to be applied to sphere
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/LOghan.jpg");
-		resman_.LoadResource(Texture, "LOghan", filename.c_str());
-
-		// Load texture to be applied to sphere
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/BOrdy.jpg");
-		resman_.LoadResource(Texture, "BOrdy", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/grass.jpg");
-		resman_.LoadResource(Texture, "Grass", filename.c_str());
-
-		//filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/Helis.jpg");
-		//resman_.LoadResource(Texture, "Helis", filename.c_str());
-
-		// Load texture to be applied to sphere
-		//filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/Tanks.jpg");
-		//resman_.LoadResource(Texture, "Tanks", filename.c_str());
-
-		//filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/Guns.jpg");
-		//resman_.LoadResource(Texture, "Guns", filename.c_str());
-
-		//filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/Waifu.jpg");
-		//resman_.LoadResource(Texture, "Waifu", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/camo.jpg");
-		resman_.LoadResource(Texture, "camo", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/dkmetal.jpg");
-		resman_.LoadResource(Texture, "dkmetal", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/metal.jpg");
-		resman_.LoadResource(Texture, "metal", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/catCamo.png");
-		resman_.LoadResource(Texture, "catCamo", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/wall.png");
-		resman_.LoadResource(Texture, "wall", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Textures/pcamo.png");
-		resman_.LoadResource(Texture, "pcamo", filename.c_str());
-
-
-
-		//Dialogue Textures
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/helicopterfuel.jpg");
-		resman_.LoadResource(Texture, "helicopterfuel", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/meltheart.jpg");
-		resman_.LoadResource(Texture, "meltheart", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/startscreen.jpg");
-		resman_.LoadResource(Texture, "startscreen", filename.c_str());
-
-
-		//conversation
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia1.png");
-		resman_.LoadResource(Texture, "dia1", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia2.png");
-		resman_.LoadResource(Texture, "dia2", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia3.png");
-		resman_.LoadResource(Texture, "dia3", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia4.png");
-		resman_.LoadResource(Texture, "dia4", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia5.png");
-		resman_.LoadResource(Texture, "dia5", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia6.png");
-		resman_.LoadResource(Texture, "dia6", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia7.png");
-		resman_.LoadResource(Texture, "dia7", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia8.png");
-		resman_.LoadResource(Texture, "dia8", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia9.png");
-		resman_.LoadResource(Texture, "dia9", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia10.png");
-		resman_.LoadResource(Texture, "dia10", filename.c_str());
-
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/Dialogue/dia11.png");
-		resman_.LoadResource(Texture, "dia11", filename.c_str());
-
-
+		// The materials compiled while the textures were loading
+		resman_.FinishMaterials();
 
 		dialogues.push_back(resman_.GetResource("dia1"));
 		dialogues.push_back(resman_.GetResource("dia2"));
@@ -292,17 +363,39 @@ namespace game {
 		player = CreatePlayer();
 		baehawk = CreateBae();
 
-		ground = CreateInstance("Ground", "GroundMesh", "ShinyTextureMaterial", "Grass");
-		ground->Scale(glm::vec3(1000, 0.0, 1000.0));
-		ground->SetPosition(glm::vec3(0.0, -15.0, 0.0));
+		// Vehicles are single meshes, with a palette for the rotor blades
+		BakePrefab(&player_mesh_, "PlayerMesh", player);
+		BakePrefab(&bae_mesh_, "BaeHawkMesh", baehawk);
+
+		// The ground is made of tiles built around the camera
+		terrain_.Init(&resman_, resman_.GetResource("ShinyTextureMaterial"), resman_.GetResource("Grass"), world);
+		player->setTerrain(&terrain_);
+		baehawk->setTerrain(&terrain_);
 
 
 		world->AddChild(player);
 		world->AddChild(baehawk);
-		world->AddChild(ground);
+
+		// Faraway enemies are drawn as pictures of their prefabs
+		impostors_.Init(&resman_, resman_.GetResource("ImpostorMaterial"), 3);
+		SceneNode *prefab = CreateInstance("TankPrefab", "PartsMesh", "ShinyTextureMaterial", "catCamo");
+		MakeTank(prefab);
+		BakePrefab(&tank_mesh_, "TankMesh", prefab);
+		tank_impostor_ = CapturePrefab(prefab);
+		prefab = CreateInstance("GunnerPrefab", "PartsMesh", "ShinyTextureMaterial", "catCamo");
+		MakeGunner(prefab);
+		BakePrefab(&gunner_mesh_, "GunnerMesh", prefab);
+		gunner_impostor_ = CapturePrefab(prefab);
+		prefab = CreateInstance("HeliPrefab", "PartsMesh", "ShinyTextureMaterial", "catCamo");
+		MakeHelli(prefab);
+		BakePrefab(&heli_mesh_, "HeliMesh", prefab);
+		heli_impostor_ = CapturePrefab(prefab);
+		scene_.SetImpostorAtlas(&impostors_);
 
 		scene_.SetRoot(world);
 
+		particles_.Init(resman_.GetResource("ParticleUpdateMaterial"), resman_.GetResource("ParticleMaterial"));
+
 
 
 	}
@@ -311,29 +404,42 @@ namespace game {
 	void Game::MainLoop(void) {
 
 		spawnBuildings();
+		// The buildings never move: draw them as a few merged meshes
+		scene_.BuildStaticBatches(&resman_);
 
 		CreateHUD();
 
 
-		// Loop while the user did not close the window
-		while (!glfwWindowShouldClose(window_)) {
+		// Loop while the user did not close the window, or for the requested
+		// number of frames in headless mode
+		std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+		while (window_ ? !glfwWindowShouldClose(window_) : (frame_count_ < options_.num_frames)) {
 
+			if (options_.skip_intro && gameState == 0) {
+				AdvanceIntro();
+			}
 
 			if (!paused) {
-				glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+				if (window_) {
+					glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+				}
 
 
 				if (animating_ && gameState != 2) {
 					static double last_time = 0;
-					double current_time = glfwGetTime();
+					double current_time = GetTime();
 					if ((current_time - last_time) > 0.01) {
 						//scene_.Update();
 
 						// Animate the sphere
 						glm::quat rotation = glm::angleAxis(glm::pi<float>() / 10.0f, glm::vec3(0.0, 0.0, 1.0));
-						t_blade->Rotate(rotation);
+						for (int i = 0; i < t_blades.size(); i++) {
+							t_blades[i]->Rotate(rotation);
+						}
 						rotation = glm::angleAxis(glm::pi<float>() / 10.0f, glm::vec3(1.0, 0.0, 0.0));
-						b_blade->Rotate(rotation);
+						for (int i = 0; i < b_blades.size(); i++) {
+							b_blades[i]->Rotate(rotation);
+						}
 
 
 						last_time = current_time;
@@ -358,20 +464,78 @@ namespace game {
 
 				if(gameState != 0 )scene_.Update();
 
-				scene_.Draw(&camera_);
+				terrain_.Update(camera_.GetPosition());
+
+				stream_.BeginFrame();
+				GPU_PROFILE_BEGIN_FRAME(profiler_);
 
-				glfwSwapBuffers(window_);
+				resolution_.Begin();
+				GPU_PROFILE_BEGIN(profiler_, "Scene");
+				scene_.Draw(&camera_, (float) GetTime());
+				GPU_PROFILE_END(profiler_);
+
+				GPU_PROFILE_BEGIN(profiler_, "Particles");
+				particles_.Update((float) GetTime());
+				particles_.Draw(&camera_);
+				GPU_PROFILE_END(profiler_);
+				resolution_.End();
+
+				GPU_PROFILE_BEGIN(profiler_, "HUD");
+				DrawHUD();
+				GPU_PROFILE_END(profiler_);
+
+				GPU_PROFILE_END_FRAME(profiler_);
+
+				if (window_) {
+					glfwSwapBuffers(window_);
+				}
+
+#ifdef GPU_PROFILER
+				// Show where the GPU time goes every few seconds
+				if (window_ && (frame_count_ % 300 == 299)) {
+					std::cout << profiler_.GetReport();
+				}
+#endif
 
 			}
-			else
+			else if (window_)
 				glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 
+			frame_count_++;
+
 			// Update other events like input handling
-			glfwPollEvents();
+			if (window_) {
+				glfwPollEvents();
+			}
+		}
+
+		// Report the speed of headless runs, and keep their last frame
+		if (!window_) {
+			glFinish();
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+			std::cout << frame_count_ << " frames, " << 1000.0 * elapsed / std::max(frame_count_, 1) << " ms per frame" << std::endl;
+			if (options_.frame_budget > 0.0f) {
+				std::cout << "Scene drawn at " << resolution_.GetScale() << " of the output size" << std::endl;
+			}
+#ifdef GPU_PROFILER
+			std::cout << profiler_.GetReport();
+#endif
+			if (!options_.capture.empty()) {
+				headless_.SaveImage(options_.capture);
+			}
 		}
 	}
 
 
+	double Game::GetTime() const {
+
+		if (!window_) {
+			return frame_count_ / 60.0;
+		}
+		return glfwGetTime();
+	}
+
+
 	void Game::mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 	{
 
@@ -428,31 +592,11 @@ namespace game {
 		//SceneNode *node = game->scene_.GetNode("SphereInstance1");
 
 		if (game->introPhase < 3 && action == GLFW_RELEASE && key != GLFW_KEY_ESCAPE) { 
-			game->introPhase = 3; 
+			game->AdvanceIntro();
 		}
 		else if (game->introPhase == 3 && action == GLFW_RELEASE) {
-			if (game->currentDialogue < game->dialogues.size()-1) game->currentDialogue++;
-			else {
-				game->introPhase = 4;
-				std::stringstream ss;
-
-				for (int i = 1; i <= game->dialogues.size(); i++) {
-					ss << i;
-					game->resman_.RemoveResource("dia" + ss.str());
-				
-				}
-					game->dialogues.erase(game->dialogues.begin(), game->dialogues.end());
-
-					game->player->SetOrientation(game->enemies[1]->GetOrientation());
-					game->baehawk->SetOrientation(game->enemies[1]->GetOrientation());
-
-
-
-			}
-			
+			game->AdvanceIntro();
 		}
-
-
 		if (!game->paused) {
 			// View control
 			float rot_factor(glm::pi<float>() / 180);
@@ -529,7 +673,7 @@ namespace game {
 
 		camera_.SetPosition(player->GetPosition() + glm::vec3(0, 1, 0));
 
-		glfwGetCursorPos(window_, &CursorXPos, &CursorYPos);
+		if (window_) glfwGetCursorPos(window_, &CursorXPos, &CursorYPos);
 
 		if (CursorXPos > OldCursorXPos) {
 
@@ -572,7 +716,7 @@ namespace game {
 
 		if (firstPerson) camera_.SetPosition(player->GetPosition());
 
-		glfwGetCursorPos(window_, &OldCursorXPos, &OldCursorYPos);
+		if (window_) glfwGetCursorPos(window_, &OldCursorXPos, &OldCursorYPos);
 
 		if (q_input) {
 			camera_.Yaw(rot_factor* 0.573f);
@@ -629,6 +773,7 @@ namespace game {
 		void* ptr = glfwGetWindowUserPointer(window);
 		Game *game = (Game *)ptr;
 		game->camera_.SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+		game->resolution_.Resize(width, height);
 	}
 
 
@@ -671,6 +816,8 @@ namespace game {
 					bullets.erase(bullets.begin() + (i));
 
 					if (enemies[j]->getHealth() <= 0) {
+						// Burst of fire where the enemy was
+						particles_.Emit(enemies[j]->GetPosition(), glm::vec3(0.0, 2.0, 0.0), 6.0f, 600, 1.5f, glm::vec4(1.0, 0.5, 0.1, 1.0));
 						enemies[j]->die();
 						world->removeChild(enemies[j]);
 						affection++;
@@ -716,18 +863,6 @@ namespace game {
 
 	if (player->getHealth() < 0) gameState = 2;
 
-	Health->SetPosition(camera_.GetPosition() + camera_.GetForward()*glm::vec3(0.5, 0.5, 0.5) +camera_.GetSide() * glm::vec3(0.0, 0.0, 0.0) + glm::normalize(glm::cross(camera_.GetForward(), camera_.GetSide())) * -glm::vec3(0.08, 0.08, 0.08));
-	Health->SetOrientation(camera_.GetOrientation());
-	Health->SetScale(glm::vec3(player->getHealth() / 2000, 0.008, 0.0));
-
-	//Health->Translate(glm::vec3(-0.0, -0.0, -0.5));
-
-	Reticle->SetPosition(camera_.GetPosition() + camera_.GetForward()*glm::vec3(0.5, 0.5, 0.5));
-	Reticle->SetOrientation(camera_.GetOrientation());
-
-	baehawk->getAffection()->SetPosition(baehawk->GetPosition() - glm::vec3(0, -2, 0));
-	baehawk->getAffection()->SetOrientation(camera_.GetOrientation());
-	baehawk->getAffection()->SetScale(glm::vec3(affection, 0.4, 0));
 
 
 }
@@ -735,9 +870,12 @@ namespace game {
 
 void Game::GameOver() {
 	//scene_.RemoveNode(player);
-	DialogueBox->SetTexture(resman_.GetResource("Flame"));
-	DialogueBox->SetScale(glm::vec3(3.0f,3.0f,3.0f));
-	DialogueBox->SetPosition(player->GetPosition());
+	if (!Flame) {
+		Flame = CreateInstance("Flame", "PartsMesh", "ShinyTextureMaterial", "Flame");
+		Flame->SetScale(glm::vec3(3.0f, 3.0f, 3.0f));
+		world->AddChild(Flame);
+	}
+	Flame->SetPosition(player->GetPosition());
 	camera_.SetPosition(player->GetPosition() + glm::vec3(0, 1, 0));
 	camera_.Translate(-camera_.GetForward()*zoom);
 	camera_.Translate(glm::vec3(0, 0.5, 0));
@@ -749,21 +887,18 @@ void Game::GameOver() {
 void Game::Intro() {
 	camera_.SetPosition(glm::vec3(100000.0, 0.0, 0.0));
 
-	DialogueBox->SetPosition((camera_.GetPosition() + camera_.GetForward()*glm::vec3(AnimationTimer, AnimationTimer, AnimationTimer))+ glm::vec3(0.0,0.0,0.0));
-	
-	DialogueBox->SetOrientation(camera_.GetOrientation());
 	if (introPhase < 2) {
 		AnimationTimer--;
 		if (AnimationTimer == 3) _sleep(5000);
 		if (AnimationTimer < -4 && introPhase == 0) {
-			DialogueBox->SetTexture(resman_.GetResource("meltheart"));
+			DialogueTexture = resman_.GetResource("meltheart");
 			AnimationTimer = 100;
 			introPhase = 1;
 		}
 		else if (AnimationTimer < -4 && introPhase == 1) { 
 			introPhase = 2; 
 			AnimationTimer = 3;
-			DialogueBox->SetTexture(resman_.GetResource("startscreen"));
+			DialogueTexture = resman_.GetResource("startscreen");
 		}
 	}
 	else if (introPhase == 2);
@@ -775,9 +910,9 @@ void Game::Intro() {
 		if (currentDialogue >= 3 && currentDialogue <= 4) { 
 			camera_.SetPosition(glm::vec3(0.7, -12.0, 0.0)); 
 			if (enemies.size()<32) {
-				CreateGun(glm::vec3(-5.0, -13.0, -20.0));
-				CreateHeli(glm::vec3(0.0, -13.0, -20.0));
-				CreateTank(glm::vec3(5.0, -13.0, -20.0));
+				CreateGun(glm::vec3(-5.0, terrain_.GetHeight(-5.0, -20.0) + 2.0, -20.0));
+				CreateHeli(glm::vec3(0.0, terrain_.GetHeight(0.0, -20.0) + 2.0, -20.0));
+				CreateTank(glm::vec3(5.0, terrain_.GetHeight(5.0, -20.0) + 2.0, -20.0));
 				glm::quat rotation = glm::angleAxis(glm::pi<float>() /1.2f, glm::vec3(0.0, 0.0, 1.0));
 				enemies[30]->Rotate(rotation);
 				enemies[31]->Rotate(rotation);
@@ -790,10 +925,7 @@ void Game::Intro() {
 		player->SetOrientation(glm::angleAxis(4.7f, camera_.GetSide()) * (glm::angleAxis(2.8f, camera_.GetForward())) * camera_.GetOrientation());
 		baehawk->SetPosition(glm::vec3(1.1, -0.7, -10.0));
 		baehawk->SetOrientation(glm::angleAxis(4.7f, camera_.GetSide()) * (glm::angleAxis(3.7f, camera_.GetForward())) * camera_.GetOrientation());
-		DialogueBox->SetPosition(camera_.GetPosition() + camera_.GetForward()*glm::vec3(0.5, 0.5, 0.5) + camera_.GetSide() * glm::vec3(0.0, 0.0, 0.0) + glm::normalize(glm::cross(camera_.GetForward(), camera_.GetSide())) * -glm::vec3(-0.065, -0.065, -0.065));
-		DialogueBox->SetOrientation(camera_.GetOrientation());
-		DialogueBox->SetScale(glm::vec3(0.1, 0.040, 0.0));
-		DialogueBox->SetTexture(dialogues[currentDialogue]);
+		DialogueTexture = dialogues[currentDialogue];
 
 		
 
@@ -801,6 +933,29 @@ void Game::Intro() {
 	else if (introPhase == 4) gameState = 1;
 }
 
+void Game::AdvanceIntro() {
+	if (introPhase < 3) {
+		introPhase = 3;
+	}
+	else if (introPhase == 3) {
+		if (currentDialogue < dialogues.size()-1) currentDialogue++;
+		else {
+			introPhase = 4;
+			std::stringstream ss;
+
+			for (int i = 1; i <= dialogues.size(); i++) {
+				ss << i;
+				resman_.RemoveResource("dia" + ss.str());
+
+			}
+			dialogues.erase(dialogues.begin(), dialogues.end());
+
+			player->SetOrientation(enemies[1]->GetOrientation());
+			baehawk->SetOrientation(enemies[1]->GetOrientation());
+		}
+	}
+}
+
 
 
 
@@ -906,12 +1061,7 @@ BaeHawk *Game::CreateBae() {
 
 	Resource *tex = resman_.GetResource("BOrdy");
 
-	SceneNode *meter = CreateInstance("AffectionMeter", "PartsMesh", "ShinyTextureMaterial", "metal");
-	meter->SetScale(glm::vec3(1,0.4,0));
-
-	world->AddChild(meter);
-
-	BaeHawk *bae = new BaeHawk("Bae", geom, mat, tex, meter);
+	BaeHawk *bae = new BaeHawk("Bae", geom, mat, tex);
 	//scene_.AddNode(player);
 
 	bae->SetForward(glm::vec3(1.0, 0.0, 0.0));
@@ -1030,6 +1180,8 @@ void Game::MakePlayer(Player* player) {
 	hell_body->AddChild(t_blade);
 	hell_body->AddChild(bump);
 	b_wing->AddChild(b_blade);
+	t_blades.push_back(t_blade);
+	b_blades.push_back(b_blade);
 
 }
 
@@ -1133,6 +1285,7 @@ void Game::CreateMissles(glm::vec3 position, glm::vec3 Forwardvelocity) {
 			bul->SetPosition(position);
 			//bul->SetOrientation(glm::normalize(glm::angleAxis(glm::pi<float>()*((float)rand() / RAND_MAX), glm::vec3(((float)rand() / RAND_MAX), ((float)rand() / RAND_MAX), ((float)rand() / RAND_MAX)))));
 			bul->SetVelocity(velocity * speed);
+			bul->SetTrail(&particles_);
 
 			bullets.push_back(bul);
 
@@ -1165,9 +1318,12 @@ void Game::CreateTank(glm::vec3 position) {
 	// Create asteroid instance
 	Tanks *enemy = new Tanks(name, geom, mat, tex);
 	enemy->setTarget(player);
+	enemy->setTerrain(&terrain_);
 	enemy->SetForward(glm::vec3(1.0, 0.0, 0.0));
 
-	MakeTank(enemy);
+	enemy->SetPrefabMesh(&tank_mesh_);
+	enemy->SetImpostor(tank_impostor_);
+	enemy->SetDrawPass(EnemyPass);
 
 	//scene_.AddNode(enemy);
 	world->AddChild(enemy);
@@ -1209,9 +1365,12 @@ void Game::CreateGun(glm::vec3 position) {
 	// Create asteroid instance
 	Guns *enemy = new Guns(name, geom, mat, tex);
 	enemy->setTarget(player);
+	enemy->setTerrain(&terrain_);
 	enemy->SetForward(glm::vec3(1.0, 0.0, 0.0));
 
-	MakeGunner(enemy);
+	enemy->SetPrefabMesh(&gunner_mesh_);
+	enemy->SetImpostor(gunner_impostor_);
+	enemy->SetDrawPass(EnemyPass);
 
 	//scene_.AddNode(enemy);
 	world->AddChild(enemy);
@@ -1252,8 +1411,11 @@ void Game::CreateHeli(glm::vec3 position) {
 	// Create asteroid instance
 	Helis *enemy = new Helis(name, geom, mat, tex);
 	enemy->setTarget(player);
+	enemy->setTerrain(&terrain_);
 	enemy->SetForward(glm::vec3(1.0, 0.0, 0.0));
-	MakeHelli(enemy);
+	enemy->SetPrefabMesh(&heli_mesh_);
+	enemy->SetImpostor(heli_impostor_);
+	enemy->SetDrawPass(EnemyPass);
 
 	//scene_.AddNode(enemy);
 	world->AddChild(enemy);
@@ -1345,10 +1507,10 @@ void Game::MakeHelli(SceneNode *enemy) {
 	enemy->SetPosition(glm::vec3(0.0, 30.0, -2.0));
 
 
-	SceneNode* t_blades = CreateInstance("t_blades", "PartsMesh", "ShinyTextureMaterial", "dkmetal");
-	t_blades->SetOrientation(glm::angleAxis(0.0f, camera_.GetForward()) * camera_.GetOrientation());
-	t_blades->SetPosition(glm::vec3(0.0, 0.5, 0.5));
-	t_blades->Scale(glm::vec3(4.0, 0.25, 0.01));
+	// Blades of its own, shaped like the ones of the player
+	SceneNode* t_rotor = CreateInstance("t_blades", "PartsMesh", "ShinyTextureMaterial", "dkmetal");
+	t_rotor->Scale(glm::vec3(3.5, 0.3, 0.05));
+	t_rotor->Translate(glm::vec3(0.0, 0.0, 0.6));
 
 
 	SceneNode* tail = CreateInstance("tail", "PartsMesh", "ShinyTextureMaterial", "dkmetal");
@@ -1359,9 +1521,9 @@ void Game::MakeHelli(SceneNode *enemy) {
 	wings->Scale(glm::vec3(1.8, 0.4, 0.1));
 	wings->SetPosition(glm::vec3(0.0, 0.25, -0.15));
 
-	SceneNode* b_blades = CreateInstance("b_blades", "PartsMesh", "ShinyTextureMaterial", "dkmetal");
-	b_blades->Scale(glm::vec3(0.01, 0.1, 1.0));
-	b_blades->SetPosition(glm::vec3(-0.1, -0.7, 0.0));
+	SceneNode* b_rotor = CreateInstance("b_blades", "PartsMesh", "ShinyTextureMaterial", "dkmetal");
+	b_rotor->Scale(glm::vec3(0.05, 1.25, 0.15));
+	b_rotor->Translate(glm::vec3(-0.05, 0.0, 0.0));
 
 	SceneNode *body = CreateInstance("hellBody", "PartsMesh", "ShinyTextureMaterial", "catCamo");
 	body->Scale(glm::vec3(1.01, 1.99, 1.01));
@@ -1369,10 +1531,49 @@ void Game::MakeHelli(SceneNode *enemy) {
 
 
 	enemy->AddChild(body);
-	enemy->AddChild(t_blade);
+	enemy->AddChild(t_rotor);
 	enemy->AddChild(tail);
 	enemy->AddChild(wings);
-	tail->AddChild(b_blade);
+	tail->AddChild(b_rotor);
+	t_blades.push_back(t_rotor);
+	b_blades.push_back(b_rotor);
+}
+
+
+void Game::BakePrefab(PrefabMesh *mesh, const std::string &name, SceneNode *prefab) {
+
+	std::vector<const SceneNode *> rotor(t_blades.begin(), t_blades.end());
+	rotor.insert(rotor.end(), b_blades.begin(), b_blades.end());
+	mesh->Bake(&resman_, name, resman_.GetResource("PrefabMaterial"), prefab, rotor);
+
+	// Only the mesh is kept; the rotor blades stay out of the scene, where
+	// the game turns them and the mesh reads them
+	std::stack<SceneNode *> nodes;
+	for (std::vector<SceneNode *>::const_iterator it = prefab->children_begin(); it != prefab->children_end(); it++) {
+		nodes.push(*it);
+	}
+	while (!nodes.empty()) {
+		SceneNode *current = nodes.top();
+		nodes.pop();
+		for (std::vector<SceneNode *>::const_iterator it = current->children_begin(); it != current->children_end(); it++) {
+			nodes.push(*it);
+		}
+		if (std::find(rotor.begin(), rotor.end(), current) == rotor.end()) {
+			delete current;
+		} else {
+			current->parent = NULL;
+		}
+	}
+	prefab->children.clear();
+	prefab->SetPrefabMesh(mesh);
+}
+
+
+const Impostor *Game::CapturePrefab(SceneNode *prefab) {
+
+	const Impostor *impostor = impostors_.AddPrefab(prefab, &stream_);
+	delete prefab;
+	return impostor;
 }
 
 
@@ -1393,31 +1594,62 @@ bool Game::collision(SceneNode *node1, SceneNode *node2) {
 
 
 void Game::CreateHUD() {
-	//Create HUD
-	Health = CreateInstance("Health", "GroundMesh", "ShinyTextureMaterial", "metal");
-	Health->SetScale(glm::vec3(0.1, 0.008, 0.00));
 
-	world->AddChild(Health);
+	hud_.Init(resman_.GetResource("OverlayMaterial"));
+	DialogueTexture = resman_.GetResource("helicopterfuel");
+}
 
-	Reticle = CreateInstance("Reticle", "GroundMesh", "ShinyTextureMaterial", "metal");
-	Reticle->SetScale(glm::vec3(0.001, 0.001, 0.00));
 
-	world->AddChild(Reticle);
+void Game::DrawHUD() {
 
-	DialogueBox = CreateInstance("DialogueBox", "PartsMesh", "ShinyTextureMaterial", "helicopterfuel");
-	DialogueBox->SetScale(glm::vec3(1, 1, 0));
+	float width = camera_.GetViewportWidth();
+	float height = camera_.GetViewportHeight();
+	glm::vec2 center(width / 2, height / 2);
 
-	world->AddChild(DialogueBox);
+	hud_.Clear();
 
-	
-	//End of Create HUD
+	if (gameState == 0) {
+		if (introPhase < 3) {
+			// Title panels fly towards the camera, as a unit square placed
+			// 'AnimationTimer' units ahead
+			if (AnimationTimer > 0) {
+				float size = camera_.GetScreenSize(camera_.GetPosition() + camera_.GetForward()*(float)AnimationTimer, 0.5);
+				hud_.AddQuad(center - glm::vec2(size / 2), center + glm::vec2(size / 2), DialogueTexture);
+			}
+		}
+		else if (introPhase == 3) {
+			glm::vec2 size = hud_dialogue_size_g * height;
+			glm::vec2 panel_center(center.x, hud_dialogue_y_g * height);
+			hud_.AddQuad(panel_center - size / 2.0f, panel_center + size / 2.0f, DialogueTexture);
+		}
+	}
+	else if (gameState == 1) {
+		// Health bar, centered at the bottom
+		float health_width = std::max(player->getHealth(), 0.0f) * hud_health_width_g * height;
+		glm::vec2 health_min(center.x - health_width / 2, hud_health_y_g * height);
+		hud_.AddQuad(health_min, health_min + glm::vec2(health_width, hud_bar_height_g * height), hud_health_color_g);
+
+		// Reticle
+		glm::vec2 reticle(std::max(hud_reticle_size_g * height, 2.0f) / 2);
+		hud_.AddQuad(center - reticle, center + reticle, hud_reticle_color_g);
+
+		// Affection meter, floating above Bae and sized as if it were in
+		// the world
+		glm::vec3 anchor = baehawk->GetPosition() + glm::vec3(0, 2, 0);
+		glm::vec2 meter_center;
+		if (affection > 0 && camera_.GetScreenPosition(anchor, meter_center)) {
+			glm::vec2 size(camera_.GetScreenSize(anchor, affection / 2.0f), camera_.GetScreenSize(anchor, 0.2f));
+			hud_.AddQuad(meter_center - size / 2.0f, meter_center + size / 2.0f, hud_affection_color_g);
+		}
+	}
 
+	hud_.Draw(width, height, &stream_);
 }
 
 
 void Game::spawnEnemies(void) {
 
-	if (enemies.size() < 51 && enemy_spawn_timer < 0) {
+	if (enemies.size() < max_enemies_g && enemy_spawn_timer < 0) {
 
 		int i = rand() % 2;
 		if (i == 0)
@@ -1439,7 +1671,7 @@ void Game::spawnBuildings(void) {
 	std::string index;
 	std::string name;
 
-	float x, y, z;
+	float x, y, z, base;
 
 
 	for (int i = 0; i < 60; i++) {
@@ -1451,14 +1683,20 @@ void Game::spawnBuildings(void) {
 		x = rand() % 1000 - 500;
 		y = rand() % 10 + 2;
 		z = rand() % 1000 - 500;
+		base = terrain_.GetHeight(x, z) + 2;
 
 		SceneNode *newBuilding = CreateInstance(name, "PartsMesh", "ShinyTextureMaterial", "wall");
 		newBuilding->SetScale(glm::vec3(rand() % 6 + 2, y, rand() % 6 + 3));
-		newBuilding->SetPosition(glm::vec3(x, -13, z));
+		newBuilding->SetPosition(glm::vec3(x, base, z));
+		// Buildings are solid boxes that hide what stands behind them, and
+		// never move
+		newBuilding->SetOccluder(true);
+		newBuilding->SetStatic(true);
+		newBuilding->SetDrawPass(BuildingPass);
 		world->AddChild(newBuilding);
 
 		if(i % 2 == 0)
-		CreateGun(glm::vec3(x, y / 2 - 13, z));
+		CreateGun(glm::vec3(x, y / 2 + base, z));
 
 		buildings.push_back(newBuilding);
 
@@ -1468,25 +1706,6 @@ void Game::spawnBuildings(void) {
 
 
 
-}
-
-void Game::ViewOrtho(int x, int y)							// Set Up An Ortho View
-{
-	glMatrixMode(GL_PROJECTION);					// Select Projection
-	glPushMatrix();							// Push The Matrix
-	glLoadIdentity();						// Reset The Matrix
-	glOrtho(0, x, y, 0, -1, 1);				// Select Ortho Mode
-	glMatrixMode(GL_MODELVIEW);					// Select Modelview Matrix
-	glPushMatrix();							// Push The Matrix
-	glLoadIdentity();						// Reset The Matrix
-}
-
-void Game::ViewPerspective(void)							// Set Up A Perspective View
-{
-	glMatrixMode(GL_PROJECTION);					// Select Projection
-	glPopMatrix();							// Pop The Matrix
-	glMatrixMode(GL_MODELVIEW);					// Select Modelview
-	glPopMatrix();							// Pop The Matrix
 }
 
 } // namespace game
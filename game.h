@@ -19,6 +19,15 @@
 #include "Tanks.h"
 #include "missle.h"
 #include "BaeHawk.h"
+#include "overlay.h"
+#include "particle_system.h"
+#include "headless_context.h"
+#include "gpu_profiler.h"
+#include "stream_buffer.h"
+#include "terrain.h"
+#include "impostor_atlas.h"
+#include "dynamic_resolution.h"
+#include "prefab_mesh.h"
 
 namespace game {
 
@@ -33,6 +42,21 @@ namespace game {
             virtual ~GameException() throw() {};
     };
 
+    // Startup settings, read from the command line
+    struct GameOptions {
+        bool headless; // Draw offscreen, without a window
+        int width, height; // Size of the offscreen framebuffer
+        int num_frames; // Frames drawn before quitting in headless mode
+        bool skip_intro; // Advance through the intro without input
+        std::string capture; // Image file receiving the last headless frame
+        std::string profile_log; // File receiving the GPU time of each frame
+        float frame_budget; // GPU time of the scene in milliseconds, over
+                            // which its resolution drops; 0 keeps it full,
+                            // negative picks the default of the mode
+
+        GameOptions(void) : headless(false), width(800), height(600), num_frames(300), skip_intro(false), frame_budget(-1.0f) {}
+    };
+
     // Game application
     class Game {
 
@@ -41,7 +65,7 @@ namespace game {
             Game(void);
             ~Game();
             // Call Init() before calling any other method
-            void Init(void); 
+            void Init(const GameOptions &options = GameOptions()); 
             // Set up resources for the game
             void SetupResources(void);
             // Set up initial scene
@@ -61,9 +85,23 @@ namespace game {
 
 			void MakeBae(SceneNode* player);
 
+			// Merge the parts of a prefab built by one of the functions
+			// above into 'mesh', and draw it instead of the parts; the
+			// rotor blades keep turning
+			void BakePrefab(PrefabMesh *mesh, const std::string &name, SceneNode *prefab);
+
+			// Take the pictures of a baked prefab for the impostors, then
+			// delete it
+			const Impostor *CapturePrefab(SceneNode *prefab);
+
         private:
 
-			SceneNode *world, *ground, *t_blade, *tail, *wings, *b_blade;
+			SceneNode *world, *t_blade, *tail, *wings, *b_blade;
+
+			// Rotor blades of the player and of each helicopter, turned
+			// together; every model has its own, since a node is placed
+			// under a single parent
+			std::vector<SceneNode *> t_blades, b_blades;
 
 			Player *player;
 			BaeHawk * baehawk;
@@ -82,15 +120,43 @@ namespace game {
 			float zoom;
 
 			bool firstPerson;
-            // GLFW window
+            // GLFW window, NULL in headless mode
             GLFWwindow* window_;
 
+            // Context and framebuffer replacing the window in headless mode
+            GameOptions options_;
+            HeadlessContext headless_;
+            int frame_count_; // Frames drawn so far
+
             // Scene graph containing all nodes to render
             SceneGraph scene_;
 
             // Resources available to the game
             ResourceManager resman_;
 
+            // Explosions and missile trails, simulated on the GPU
+            ParticleSystem particles_;
+
+            // GPU time of the parts of each frame, in GPU_PROFILER builds
+            GpuProfiler profiler_;
+
+            // Ring of buffers receiving the data of each frame
+            StreamBuffer stream_;
+
+            // Target of the scene, smaller than the window while the GPU
+            // cannot keep up
+            DynamicResolution resolution_;
+
+            // Ground of the world, with its height under any point
+            Terrain terrain_;
+
+            // Pictures of the enemy prefabs, drawn for faraway enemies
+            ImpostorAtlas impostors_;
+            const Impostor *tank_impostor_, *gunner_impostor_, *heli_impostor_;
+
+            // Vehicles baked into single meshes
+            PrefabMesh player_mesh_, bae_mesh_, tank_mesh_, gunner_mesh_, heli_mesh_;
+
             // Camera abstraction
             Camera camera_;
 
@@ -115,10 +181,16 @@ namespace game {
 
 			int affection;
 
-			SceneNode *Health, *Reticle, *DialogueBox;
+			// Screen-space HUD, rebuilt every frame
+			Overlay hud_;
+			// Panel shown by the HUD during the intro
+			Resource *DialogueTexture;
+			// Fire burning on the wreck of the player once the game is over
+			SceneNode *Flame;
 
             // Methods to initialize the game
             void InitWindow(void);
+            void InitHeadless(void);
             void InitView(void);
             void InitEventHandlers(void);
  
@@ -163,12 +235,17 @@ namespace game {
 			void MainGame();
 			void GameOver(void);
 			void Intro();
+			// Move to the next intro panel or dialogue line, as a key press does
+			void AdvanceIntro();
+			// Time since startup, in seconds; frames are a fixed step apart
+			// in headless mode, so that runs can be compared
+			double GetTime() const;
 
 
 			void CreateHUD();
-
-			void ViewOrtho(int,int);
-			void ViewPerspective();
+			// Fill the HUD for the current state of the game and draw it
+			// over the scene
+			void DrawHUD();
 
     }; // class Game
 
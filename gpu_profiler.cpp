@@ -0,0 +1,190 @@
+#include <stdexcept>
+#include <sstream>
+#include <iomanip>
+
+#include "gpu_profiler.h"
+
+namespace game {
+
+// Frames recorded before the results of the oldest one are read; drivers
+// rarely run more than two or three frames behind
+const size_t frames_in_flight_g = 4;
+
+// Weight of a new frame in the running average of a scope, so that the
+// average follows about the last second of frames
+const double average_weight_g = 1.0 / 60.0;
+
+
+GpuProfiler::GpuProfiler(void){
+
+    supported_ = false;
+    in_frame_ = false;
+    frames_.resize(frames_in_flight_g);
+    current_ = 0;
+    frame_number_ = 0;
+    num_dropped_ = 0;
+}
+
+
+GpuProfiler::~GpuProfiler(){
+}
+
+
+void GpuProfiler::SetLogFile(const std::string &filename){
+
+    log_.open(filename.c_str());
+    if (log_.fail()){
+        throw(std::ios_base::failure(std::string("Error opening file ")+filename));
+    }
+    log_ << "frame,scope,ms" << std::endl;
+}
+
+
+void GpuProfiler::BeginFrame(void){
+
+    // The context only exists once the first frame starts
+    if (frame_number_ == 0){
+        supported_ = GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+    }
+    if (!supported_){
+        return;
+    }
+
+    // Reuse the slot of the oldest frame, which the GPU has most likely
+    // finished by now
+    current_ = (current_ + 1) % frames_.size();
+    ReadFrame(frames_[current_]);
+    frames_[current_].number = frame_number_++;
+    in_frame_ = true;
+    Begin("Frame");
+}
+
+
+void GpuProfiler::EndFrame(void){
+
+    if (!in_frame_){
+        return;
+    }
+
+    // Close the scopes left open, then the frame itself
+    while (!open_.empty()){
+        End();
+    }
+    in_frame_ = false;
+}
+
+
+void GpuProfiler::Begin(const char *name){
+
+    if (!in_frame_){
+        return;
+    }
+
+    Measure measure;
+    measure.name = name;
+    measure.depth = (int) open_.size();
+    measure.start = NewQuery();
+    measure.stop = NewQuery();
+    glQueryCounter(measure.start, GL_TIMESTAMP);
+
+    std::vector<Measure> &measures = frames_[current_].measures;
+    open_.push_back(measures.size());
+    measures.push_back(measure);
+}
+
+
+void GpuProfiler::End(void){
+
+    if (!in_frame_ || open_.empty()){
+        return;
+    }
+
+    glQueryCounter(frames_[current_].measures[open_.back()].stop, GL_TIMESTAMP);
+    open_.pop_back();
+}
+
+
+GLuint GpuProfiler::NewQuery(void){
+
+    if (free_queries_.empty()){
+        GLuint query;
+        glGenQueries(1, &query);
+        return query;
+    }
+    GLuint query = free_queries_.back();
+    free_queries_.pop_back();
+    return query;
+}
+
+
+void GpuProfiler::ReadFrame(Frame &frame){
+
+    std::vector<Measure> &measures = frame.measures;
+    if (measures.empty()){
+        return;
+    }
+
+    // Timestamps complete in order: the frame is done once its outermost
+    // scope, which ends last, is
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(measures[0].stop, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available){
+        num_dropped_++;
+    }
+
+    for (size_t i = 0; i < measures.size(); i++){
+        if (available){
+            GLuint64 start, stop;
+            glGetQueryObjectui64v(measures[i].start, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(measures[i].stop, GL_QUERY_RESULT, &stop);
+            double ms = (stop - start) / 1.0e6;
+
+            // Scopes are few: a linear search is enough
+            size_t s = 0;
+            while ((s < stats_.size()) && (stats_[s].name != measures[i].name)){
+                s++;
+            }
+            if (s == stats_.size()){
+                Stats stats;
+                stats.name = measures[i].name;
+                stats.depth = measures[i].depth;
+                stats.average = ms;
+                stats_.push_back(stats);
+            }
+            stats_[s].average += average_weight_g*(ms - stats_[s].average);
+            stats_[s].last = ms;
+
+            if (log_.is_open()){
+                log_ << frame.number << "," << measures[i].name << "," << ms << "\n";
+            }
+        }
+        free_queries_.push_back(measures[i].start);
+        free_queries_.push_back(measures[i].stop);
+    }
+    measures.clear();
+}
+
+
+std::string GpuProfiler::GetReport(void) const {
+
+    std::stringstream ss;
+    if (!supported_){
+        ss << "GPU profiler: no timer queries on this driver" << std::endl;
+        return ss.str();
+    }
+
+    ss << "GPU time in ms (average, last frame)";
+    if (num_dropped_ > 0){
+        ss << ", " << num_dropped_ << " frames dropped";
+    }
+    ss << std::endl;
+    ss << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < stats_.size(); i++){
+        std::string label = std::string(2*stats_[i].depth, ' ') + stats_[i].name;
+        ss << "  " << std::left << std::setw(16) << label << std::right
+           << std::setw(8) << stats_[i].average << std::setw(8) << stats_[i].last << std::endl;
+    }
+    return ss.str();
+}
+
+} // namespace game
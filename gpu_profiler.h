@@ -0,0 +1,97 @@
+#ifndef GPU_PROFILER_H_
+#define GPU_PROFILER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Measures only exist in builds with GPU_PROFILER defined; otherwise the
+// macros below expand to nothing and the profiler is never called
+#ifdef GPU_PROFILER
+#define GPU_PROFILE_BEGIN_FRAME(profiler) (profiler).BeginFrame()
+#define GPU_PROFILE_END_FRAME(profiler) (profiler).EndFrame()
+#define GPU_PROFILE_BEGIN(profiler, name) (profiler).Begin(name)
+#define GPU_PROFILE_END(profiler) (profiler).End()
+#else
+#define GPU_PROFILE_BEGIN_FRAME(profiler) ((void) 0)
+#define GPU_PROFILE_END_FRAME(profiler) ((void) 0)
+#define GPU_PROFILE_BEGIN(profiler, name) ((void) 0)
+#define GPU_PROFILE_END(profiler) ((void) 0)
+#endif
+
+namespace game {
+
+    // Measures the time the GPU spends on parts of a frame, with timestamp
+    // queries written before and after each part
+    // The queries of a frame are only read a few frames later, once the
+    // GPU has reached them, so that measuring never waits for the GPU;
+    // frames whose results are still not there are dropped
+    class GpuProfiler {
+
+        public:
+            GpuProfiler(void);
+            ~GpuProfiler();
+
+            // Start and finish the measures of a frame; the whole frame is
+            // measured as a scope of its own
+            void BeginFrame(void);
+            void EndFrame(void);
+
+            // Measure the commands issued between Begin and End under
+            // 'name', which must outlive the profiler (e.g. a literal)
+            // Scopes may nest; they are ignored outside of a frame
+            void Begin(const char *name);
+            void End(void);
+
+            // Append the time of each scope of each frame to a file, as
+            // comma-separated values
+            void SetLogFile(const std::string &filename);
+
+            // Time of each scope averaged over the last frames, in
+            // milliseconds, one line per scope
+            std::string GetReport(void) const;
+
+        private:
+            // Scope measured in a frame
+            struct Measure {
+                const char *name;
+                int depth; // Number of enclosing scopes
+                GLuint start, stop; // Timestamp queries
+            };
+            // Measures of a frame waiting for their results
+            struct Frame {
+                unsigned number;
+                std::vector<Measure> measures;
+            };
+            // Running time of a scope
+            struct Stats {
+                std::string name;
+                int depth;
+                double average; // Milliseconds
+                double last;
+            };
+
+            // Read the results of a frame if they are there, and give its
+            // queries back to the pool
+            void ReadFrame(Frame &frame);
+            GLuint NewQuery(void);
+
+            bool supported_; // Whether the driver has timestamp queries
+            bool in_frame_;
+            std::vector<Frame> frames_; // Ring of frames in flight
+            size_t current_; // Frame being recorded
+            unsigned frame_number_;
+            std::vector<size_t> open_; // Scopes begun but not ended, innermost last
+            std::vector<GLuint> free_queries_;
+            std::vector<Stats> stats_; // In order of first appearance
+            size_t num_dropped_; // Frames read too late
+            std::ofstream log_;
+
+    }; // class GpuProfiler
+
+} // namespace game
+
+#endif // GPU_PROFILER_H_
@@ -0,0 +1,33 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <string>
+#include <stdint.h>
+
+namespace game {
+
+    // Starting value of a hash
+    const uint64_t hash_offset_g = 14695981039346656037ULL;
+
+    // FNV-1a hash of a block of memory, continuing from 'hash', used to
+    // name cache entries after their contents
+    inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = hash_offset_g){
+
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    inline uint64_t HashString(const std::string &str, uint64_t hash = hash_offset_g){
+
+        // Hash the terminating zero too, so that consecutive strings are
+        // not confused with their concatenation
+        return HashBytes(str.c_str(), str.size() + 1, hash);
+    }
+
+} // namespace game
+
+#endif // HASH_H_
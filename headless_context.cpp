@@ -0,0 +1,149 @@
+#include <stdexcept>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "headless_context.h"
+
+namespace game {
+
+HeadlessContext::HeadlessContext(void){
+
+#ifdef USE_EGL
+    display_ = EGL_NO_DISPLAY;
+    context_ = EGL_NO_CONTEXT;
+#endif
+    framebuffer_ = 0;
+    color_buffer_ = 0;
+    depth_buffer_ = 0;
+    width_ = 0;
+    height_ = 0;
+}
+
+
+HeadlessContext::~HeadlessContext(){
+
+#ifdef USE_EGL
+    if (display_ != EGL_NO_DISPLAY){
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context_ != EGL_NO_CONTEXT){
+            eglDestroyContext(display_, context_);
+        }
+        eglTerminate(display_);
+    }
+#endif
+}
+
+
+void HeadlessContext::Init(void){
+
+#ifdef USE_EGL
+    // Prefer the surfaceless platform, which needs no display server at
+    // all, over the default one
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless") && get_platform_display){
+        display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display_ == EGL_NO_DISPLAY){
+        display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if ((display_ == EGL_NO_DISPLAY) || !eglInitialize(display_, NULL, NULL)){
+        display_ = EGL_NO_DISPLAY;
+        throw(std::runtime_error(std::string("Could not initialize EGL")));
+    }
+
+    // The context draws into framebuffer objects only
+    const char *extensions = eglQueryString(display_, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context")){
+        throw(std::runtime_error(std::string("EGL cannot create contexts without surfaces")));
+    }
+
+    // Same kind of context as the one of the window; any configuration
+    // will do, since it never draws to a surface of EGL
+    const EGLint config_attribs[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) || (num_configs < 1)){
+        throw(std::runtime_error(std::string("EGL has no configuration for OpenGL")));
+    }
+    context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, NULL);
+    if ((context_ == EGL_NO_CONTEXT) || !eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)){
+        throw(std::runtime_error(std::string("Could not create an OpenGL context with EGL")));
+    }
+#else
+    throw(std::runtime_error(std::string("Headless mode needs EGL, which this build does not use")));
+#endif
+}
+
+
+void HeadlessContext::InitFramebuffer(int width, int height){
+
+    if ((width <= 0) || (height <= 0)){
+        throw(std::invalid_argument(std::string("Invalid size for the headless framebuffer")));
+    }
+    width_ = width;
+    height_ = height;
+
+    // Color and depth, as the window would have
+    glGenRenderbuffers(1, &color_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // Leave the framebuffer bound: it replaces the window for all drawing
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        throw(std::runtime_error(std::string("Incomplete headless framebuffer")));
+    }
+}
+
+
+int HeadlessContext::GetWidth(void) const {
+
+    return width_;
+}
+
+
+int HeadlessContext::GetHeight(void) const {
+
+    return height_;
+}
+
+
+GLuint HeadlessContext::GetFramebuffer(void) const {
+
+    return framebuffer_;
+}
+
+
+void HeadlessContext::SaveImage(const std::string &filename) const {
+
+    std::vector<unsigned char> pixels(3*width_*height_);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    std::ofstream f(filename.c_str(), std::ios::binary);
+    if (f.fail()){
+        throw(std::ios_base::failure(std::string("Error opening file ")+filename));
+    }
+
+    // OpenGL rows go upwards, image rows downwards
+    f << "P6\n" << width_ << " " << height_ << "\n255\n";
+    for (int y = height_ - 1; y >= 0; y--){
+        f.write((const char *) &pixels[3*y*width_], 3*width_);
+    }
+}
+
+} // namespace game
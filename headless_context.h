@@ -0,0 +1,53 @@
+#ifndef HEADLESS_CONTEXT_H_
+#define HEADLESS_CONTEXT_H_
+
+#include <string>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#endif
+
+namespace game {
+
+    // OpenGL context created without any window or display, drawing into
+    // a framebuffer object that stands for the window
+    // Lets the game run its full drawing path on machines without a
+    // display, e.g. for benchmarks and image comparisons with software
+    // rasterizers
+    // Only available when built with EGL (USE_EGL)
+    class HeadlessContext {
+
+        public:
+            HeadlessContext(void);
+            ~HeadlessContext();
+
+            // Create the context and make it current
+            void Init(void);
+            // Create the framebuffer drawn into and bind it; call once
+            // OpenGL functions are loaded
+            void InitFramebuffer(int width, int height);
+
+            int GetWidth(void) const;
+            int GetHeight(void) const;
+            GLuint GetFramebuffer(void) const;
+
+            // Save the contents of the framebuffer as a binary PPM image
+            void SaveImage(const std::string &filename) const;
+
+        private:
+#ifdef USE_EGL
+            EGLDisplay display_;
+            EGLContext context_;
+#endif
+            GLuint framebuffer_;
+            GLuint color_buffer_; // Renderbuffers attached to the framebuffer
+            GLuint depth_buffer_;
+            int width_, height_;
+
+    }; // class HeadlessContext
+
+} // namespace game
+
+#endif // HEADLESS_CONTEXT_H_
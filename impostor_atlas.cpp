@@ -0,0 +1,224 @@
+#include <cmath>
+#include <stack>
+#include <stdexcept>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "impostor_atlas.h"
+#include "vertex_format.h"
+
+namespace game {
+
+// Size of a picture, in pixels
+const int impostor_size_g = 128;
+
+// Pictures per prefab, taken all around it from slightly above
+const int impostor_views_g = 8;
+const float impostor_elevation_g = 15.0f; // Degrees
+
+// Field of view of the pictures, in degrees: narrow, so that the
+// perspective matches the one of faraway objects
+const float impostor_fov_g = 10.0f;
+
+// Band of distances where the quad fades in over the nodes
+const float fade_start_g = 250.0f;
+const float fade_end_g = 300.0f;
+
+
+ImpostorAtlas::ImpostorAtlas(void){
+
+    material_ = NULL;
+    quad_ = NULL;
+    texture_ = 0;
+    sampler_ = 0;
+    framebuffer_ = 0;
+    depth_buffer_ = 0;
+    max_prefabs_ = 0;
+}
+
+
+ImpostorAtlas::~ImpostorAtlas(){
+}
+
+
+void ImpostorAtlas::Init(ResourceManager *resman, const Resource *material, int max_prefabs){
+
+    if (!material || (material->GetType() != Material) || (max_prefabs <= 0)){
+        throw(std::invalid_argument(std::string("Invalid impostor atlas")));
+    }
+    material_ = material;
+    max_prefabs_ = max_prefabs;
+    impostors_.reserve(max_prefabs);
+
+    // Unit square in the xy plane, with the pictures mapped on it
+    GLfloat vertex[4*UnpackedVertexSize] = {
+        -0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+        0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+        -0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f
+    };
+    GLuint face[6] = {0, 1, 2, 0, 2, 3};
+    quad_ = resman->CreateMesh("ImpostorQuad", std::vector<GLfloat>(vertex, vertex + 4*UnpackedVertexSize), std::vector<GLuint>(face, face + 6));
+
+    resman->CreateSampler("ImpostorSampler", GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    sampler_ = resman->GetResource("ImpostorSampler")->GetResource();
+
+    // Layers for all views of all prefabs; transparent where no prefab
+    // is drawn
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, impostor_size_g, impostor_size_g, max_prefabs*impostor_views_g, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenRenderbuffers(1, &depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, impostor_size_g, impostor_size_g);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &framebuffer_);
+
+    // The fade band never changes
+    GLuint program = material->GetResource();
+    glUseProgram(program);
+    glUniform2f(glGetUniformLocation(program, "fade_range"), fade_start_g, fade_end_g);
+    glUseProgram(0);
+}
+
+
+const Impostor *ImpostorAtlas::AddPrefab(SceneNode *prefab, StreamBuffer *stream){
+
+    if (!texture_){
+        throw(std::runtime_error(std::string("Impostor atlas used before Init")));
+    }
+    if ((int) impostors_.size() >= max_prefabs_){
+        throw(std::runtime_error(std::string("No room left in the impostor atlas for ")+prefab->GetName()));
+    }
+
+    // Place the prefab where it is, and gather the nodes to draw
+    prefab->UpdateBounds(glm::mat4(1.0));
+    glm::vec3 center = prefab->GetSubtreeBoundCenter();
+    float radius = prefab->GetSubtreeBoundRadius();
+    if (radius <= 0.0f){
+        throw(std::invalid_argument(std::string("Nothing to draw in prefab ")+prefab->GetName()));
+    }
+    std::vector<SceneNode *> nodes;
+    std::stack<SceneNode *> stck;
+    stck.push(prefab);
+    while (!stck.empty()){
+        SceneNode *current = stck.top();
+        stck.pop();
+        if (!current->IsVisible()){
+            continue;
+        }
+        nodes.push_back(current);
+        for (std::vector<SceneNode *>::const_iterator it = current->children_begin(); it != current->children_end(); it++){
+            stck.push(*it);
+        }
+    }
+
+    Impostor impostor;
+    impostor.first_layer = (int) impostors_.size()*impostor_views_g;
+    impostor.orientation = glm::quat_cast(glm::mat3(prefab->GetWorldTransform()));
+
+    // Draw into the atlas, then come back to the current target
+    GLint framebuffer, viewport[4];
+    GLfloat clear_color[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+    glViewport(0, 0, impostor_size_g, impostor_size_g);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+
+    // The bounding sphere fills the picture
+    float distance = radius / std::tan(0.5f*glm::radians(impostor_fov_g));
+    Camera camera;
+    camera.SetProjection(impostor_fov_g, distance - radius, distance + radius, (GLfloat) impostor_size_g, (GLfloat) impostor_size_g);
+
+    float elevation = glm::radians(impostor_elevation_g);
+    for (int i = 0; i < impostor_views_g; i++){
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_, 0, impostor.first_layer + i);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+            throw(std::runtime_error(std::string("Incomplete impostor framebuffer")));
+        }
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Lit from the camera, so that every side is visible
+        float angle = 2.0f*glm::pi<float>()*i / impostor_views_g;
+        glm::vec3 direction(std::cos(angle)*std::cos(elevation), std::sin(elevation), std::sin(angle)*std::cos(elevation));
+        camera.SetView(center + direction*distance, center, glm::vec3(0.0, 1.0, 0.0));
+        frame_.Update(&camera, camera.GetPosition(), 0.0f, stream);
+
+        queue_.Clear();
+        for (size_t j = 0; j < nodes.size(); j++){
+            nodes[j]->Draw(&camera, &queue_);
+        }
+        queue_.Sort();
+        queue_.Submit(stream);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    impostors_.push_back(impostor);
+    return &impostors_.back();
+}
+
+
+float ImpostorAtlas::GetFadeStart(void) const {
+
+    return fade_start_g;
+}
+
+
+float ImpostorAtlas::GetFadeEnd(void) const {
+
+    return fade_end_g;
+}
+
+
+void ImpostorAtlas::Draw(const SceneNode *node, Camera *camera, RenderQueue *queue) const {
+
+    const Impostor *impostor = node->GetImpostor();
+    glm::vec3 center = node->GetSubtreeBoundCenter();
+    float radius = node->GetSubtreeBoundRadius();
+    glm::vec3 eye = camera->GetPosition();
+
+    // Direction of the camera as seen by the prefab when it was captured,
+    // which gives the closest view
+    glm::mat3 rotation(node->GetWorldTransform());
+    glm::vec3 direction = glm::mat3_cast(impostor->orientation) * (glm::transpose(rotation) * (eye - center));
+    float angle = std::atan2(direction.z, direction.x);
+    int view = (int) std::floor(angle / (2.0f*glm::pi<float>()) * impostor_views_g + 0.5f);
+    view = ((view % impostor_views_g) + impostor_views_g) % impostor_views_g;
+
+    DrawItem item;
+    item.program = material_->GetResource();
+    item.locations = &material_->GetLocations();
+    item.texture = texture_;
+    item.layer = (GLfloat) (impostor->first_layer + view);
+    item.sampler = sampler_;
+    item.vertex_array = quad_->GetVertexArray();
+    item.mode = GL_TRIANGLES;
+    item.size = quad_->GetSize();
+    item.index_type = quad_->GetIndexType();
+
+    // Square around the bounding sphere, facing the camera
+    glm::mat4 facing(glm::vec4(camera->GetSide(), 0.0), glm::vec4(camera->GetUp(), 0.0), glm::vec4(-camera->GetForward(), 0.0), glm::vec4(center, 1.0));
+    item.world_matrix = facing * glm::scale(glm::mat4(1.0), glm::vec3(2.0f*radius));
+    item.normal_matrix = glm::mat4(1.0);
+    item.palette = NULL;
+    item.palette_size = 0;
+
+    float distance = glm::length(center - eye);
+    item.key = RenderQueue::MakeKey(node->GetDrawPass(), item.program, texture_, item.vertex_array, distance / camera->GetFarClip());
+    queue->Add(item);
+}
+
+} // namespace game
@@ -0,0 +1,78 @@
+#ifndef IMPOSTOR_ATLAS_H_
+#define IMPOSTOR_ATLAS_H_
+
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "resource.h"
+#include "resource_manager.h"
+#include "scene_node.h"
+#include "camera.h"
+#include "render_queue.h"
+#include "frame_uniforms.h"
+#include "stream_buffer.h"
+
+namespace game {
+
+    // Views of one prefab in the atlas
+    struct Impostor {
+        int first_layer; // Layer of the first view
+        glm::quat orientation; // Orientation of the prefab when captured
+    };
+
+    // Pictures of prefabs made of many nodes, taken once from several
+    // directions around them, and drawn instead of the nodes when these
+    // are far away: a single camera-facing quad per instance, and a single
+    // instanced draw for all of them
+    // The pictures are the layers of a texture array; within a band of
+    // distances, the quad fades in over the nodes before they are dropped
+    class ImpostorAtlas {
+
+        public:
+            ImpostorAtlas(void);
+            ~ImpostorAtlas();
+
+            // Create room for 'max_prefabs' prefabs, drawn with 'material'
+            // (the impostor shaders); call once the materials are linked
+            void Init(ResourceManager *resman, const Resource *material, int max_prefabs);
+
+            // Take the pictures of the subtree of 'prefab', which needs not
+            // be part of the scene, and return the impostor to set on its
+            // instances
+            // The data of the draws goes to 'stream'
+            const Impostor *AddPrefab(SceneNode *prefab, StreamBuffer *stream);
+
+            // Distances to the camera where the quad starts fading in, and
+            // where the nodes stop being drawn
+            float GetFadeStart(void) const;
+            float GetFadeEnd(void) const;
+
+            // Add the quad of 'node', whose bounds are up to date, to
+            // 'queue'
+            void Draw(const SceneNode *node, Camera *camera, RenderQueue *queue) const;
+
+        private:
+            const Resource *material_; // Impostor shaders
+            const Resource *quad_; // Unit square, facing +z
+            GLuint texture_; // Texture array with one view per layer
+            GLuint sampler_;
+            GLuint framebuffer_; // Target of the pictures
+            GLuint depth_buffer_;
+            std::vector<Impostor> impostors_; // Room for all prefabs, so
+                                              // that pointers stay valid
+            int max_prefabs_;
+
+            // Draws of the pictures
+            RenderQueue queue_;
+            FrameUniforms frame_;
+
+    }; // class ImpostorAtlas
+
+} // namespace game
+
+#endif // IMPOSTOR_ATLAS_H_
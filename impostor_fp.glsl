@@ -0,0 +1,40 @@
+#version 140
+
+// Attributes passed from the vertex shader
+in vec2 uv_interp;
+flat in float layer_interp;
+flat in float fade_interp;
+
+// Color of the fragment
+out vec4 frag_color;
+
+// Uniform (global) buffer
+uniform sampler2DArray texture_map;
+
+// Thresholds of an ordered dither over 4x4 pixels
+const float dither[16] = float[16](
+     0.0,  8.0,  2.0, 10.0,
+    12.0,  4.0, 14.0,  6.0,
+     3.0, 11.0,  1.0,  9.0,
+    15.0,  7.0, 13.0,  5.0);
+
+
+void main() 
+{
+    // Pictures are lit already, and transparent around the prefab
+    vec4 pixel = texture(texture_map, vec3(uv_interp, layer_interp));
+    if (pixel.a < 0.5){
+        discard;
+    }
+
+    // While fading in, keep a growing share of the pixels, so that the
+    // nodes behind show through the others
+    ivec2 cell = ivec2(gl_FragCoord.xy) % 4;
+    if (fade_interp * 16.0 <= dither[cell.y*4 + cell.x]){
+        discard;
+    }
+
+    // The transparent texels are black, so filtering darkens the edges in
+    // proportion to their coverage: undo it
+    frag_color = vec4(pixel.rgb / pixel.a, 1.0);
+}
@@ -0,0 +1,41 @@
+#version 140
+
+// Vertex buffer
+in vec3 vertex;
+in vec2 uv;
+
+// Instance buffer, one entry per impostor: the layer is the view to show
+in mat4 world_mat;
+in float layer;
+
+// Per-frame uniform buffer, shared by all programs
+// Keep in sync with FrameBlock in frame_uniforms.h
+layout(std140) uniform FrameBlock {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    vec4 light_position;
+    float timer;
+};
+
+// Distances where the impostor starts and ends fading in
+uniform vec2 fade_range;
+
+// Attributes forwarded to the fragment shader
+out vec2 uv_interp;
+flat out float layer_interp;
+flat out float fade_interp;
+
+
+void main()
+{
+    gl_Position = view_projection_mat * world_mat * vec4(vertex, 1.0);
+
+    uv_interp = uv;
+
+    layer_interp = layer;
+
+    // Same for the whole quad: distance of its center
+    float distance = length(vec3(view_mat * world_mat[3]));
+    fade_interp = clamp((distance - fade_range.x) / (fade_range.y - fade_range.x), 0.0, 1.0);
+}
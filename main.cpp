@@ -1,18 +1,57 @@
 #include <iostream>
 #include <exception>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
 #include "game.h"
 
 // Macro for printing exceptions
 #define PrintException(exception_object)\
 	std::cerr << exception_object.what() << std::endl
 
+// Read the startup settings from the command line
+// Returns false if an argument is not understood
+static bool ParseOptions(int argc, char *argv[], game::GameOptions &options){
+
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if (arg == "--headless"){
+            options.headless = true;
+        } else if (arg == "--skip-intro"){
+            options.skip_intro = true;
+        } else if ((arg == "--size") && has_value){
+            if ((sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) || (options.width <= 0) || (options.height <= 0)){
+                return false;
+            }
+        } else if ((arg == "--frames") && has_value){
+            options.num_frames = atoi(argv[++i]);
+        } else if ((arg == "--capture") && has_value){
+            options.capture = argv[++i];
+        } else if ((arg == "--profile-log") && has_value){
+            options.profile_log = argv[++i];
+        } else if ((arg == "--frame-budget") && has_value){
+            options.frame_budget = (float) atof(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 // Main function that builds and runs the game
-int main(void){
+int main(int argc, char *argv[]){
     game::Game app; // Game application
 
+    game::GameOptions options;
+    if (!ParseOptions(argc, argv, options)){
+        std::cerr << "Usage: " << argv[0] << " [--headless] [--size WIDTHxHEIGHT] [--frames N] [--skip-intro] [--capture FILE.ppm] [--profile-log FILE.csv] [--frame-budget MS]" << std::endl;
+        return 1;
+    }
+
     try {
         // Initialize game
-        app.Init();
+        app.Init(options);
         // Setup the main resources and scene in the game
         app.SetupResources();
         app.SetupScene();
@@ -21,6 +60,10 @@ int main(void){
     }
     catch (std::exception &e){
         PrintException(e);
+        // Nobody is there to read the message in headless mode
+        if (options.headless){
+            return 1;
+        }
 		while (1);
     }
 
@@ -1,11 +1,14 @@
-#version 130
+#version 140
 
 // Attributes passed from the vertex shader
 in vec4 color_interp;
 
+// Color of the fragment
+out vec4 frag_color;
+
 
 void main() 
 {
-	gl_FragColor = color_interp;
-	//gl_FragColor = vec4(0.6, 0.6, 0.6, 1.0);
+	frag_color = color_interp;
+	//frag_color = vec4(0.6, 0.6, 0.6, 1.0);
 }
@@ -1,13 +1,21 @@
-#version 130
+#version 140
 
 // Vertex buffer
 in vec3 vertex;
 in vec3 color;
 
-// Uniform (global) buffer
-uniform mat4 world_mat;
-uniform mat4 view_mat;
-uniform mat4 projection_mat;
+// Instance buffer, one entry per drawn node
+in mat4 world_mat;
+
+// Per-frame uniform buffer, shared by all programs
+// Keep in sync with FrameBlock in frame_uniforms.h
+layout(std140) uniform FrameBlock {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    vec4 light_position;
+    float timer;
+};
 
 // Attributes forwarded to the fragment shader
 out vec4 color_interp;
@@ -15,7 +23,7 @@ out vec4 color_interp;
 
 void main()
 {
-    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+    gl_Position = view_projection_mat * world_mat * vec4(vertex, 1.0);
 
     color_interp = vec4(color, 1.0);
 }
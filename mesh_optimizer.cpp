@@ -0,0 +1,252 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+#include "mesh_optimizer.h"
+#include "vertex_format.h"
+#include "hash.h"
+
+namespace game {
+
+// Number of vertices in the simulated post-transform cache; larger than
+// the real caches, which favours reuse in any of them
+const int cache_size_g = 32;
+
+// Weights of the vertex score of Forsyth's algorithm
+const float cache_decay_power_g = 1.5f;
+const float last_triangle_score_g = 0.75f;
+const float valence_boost_scale_g = 2.0f;
+const float valence_boost_power_g = 0.5f;
+
+// Index of the vertices not yet placed by OptimizeVertexFetch
+const GLuint unused_vertex_g = 0xFFFFFFFF;
+
+
+// Score of a vertex from its position in the cache (-1 if not there) and
+// number of triangles still to draw with it
+// Vertices just used score high, so that their neighbours come next;
+// vertices left with few triangles do too, so that they are not left
+// behind to be transformed again later
+static float VertexScore(int cache_position, int remaining){
+
+    if (remaining == 0){
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0){
+        if (cache_position < 3){
+            // Part of the last triangle: fixed score, so that the next
+            // triangle does not favour one of its edges
+            score = last_triangle_score_g;
+        } else {
+            float scale = 1.0f / (cache_size_g - 3);
+            score = std::pow(1.0f - (cache_position - 3)*scale, cache_decay_power_g);
+        }
+    }
+    score += valence_boost_scale_g*std::pow((float) remaining, -valence_boost_power_g);
+    return score;
+}
+
+
+void MeshOptimizer::Optimize(std::vector<GLfloat> &vertex, std::vector<GLuint> &face){
+
+    WeldVertices(vertex, face);
+    OptimizeVertexCache(face, vertex.size() / UnpackedVertexSize);
+    OptimizeVertexFetch(vertex, face);
+}
+
+
+void MeshOptimizer::WeldVertices(std::vector<GLfloat> &vertex, std::vector<GLuint> &face){
+
+    const size_t vertex_bytes = UnpackedVertexSize*sizeof(GLfloat);
+    size_t num_vertices = vertex.size() / UnpackedVertexSize;
+
+    // Vertices are looked up by a hash of their attributes, and compared
+    // in full when hashes match
+    std::vector<GLfloat> welded;
+    welded.reserve(vertex.size());
+    std::vector<GLuint> remap(num_vertices);
+    std::unordered_multimap<uint64_t, GLuint> unique;
+    for (size_t i = 0; i < num_vertices; i++){
+        const GLfloat *attributes = &vertex[i*UnpackedVertexSize];
+        uint64_t hash = HashBytes(attributes, vertex_bytes);
+
+        GLuint index = (GLuint) (welded.size() / UnpackedVertexSize);
+        bool found = false;
+        std::pair<std::unordered_multimap<uint64_t, GLuint>::iterator, std::unordered_multimap<uint64_t, GLuint>::iterator> range = unique.equal_range(hash);
+        for (std::unordered_multimap<uint64_t, GLuint>::iterator it = range.first; it != range.second; it++){
+            if (memcmp(&welded[it->second*UnpackedVertexSize], attributes, vertex_bytes) == 0){
+                index = it->second;
+                found = true;
+                break;
+            }
+        }
+        if (!found){
+            welded.insert(welded.end(), attributes, attributes + UnpackedVertexSize);
+            unique.insert(std::make_pair(hash, index));
+        }
+        remap[i] = index;
+    }
+
+    // Triangles with a repeated vertex have no area
+    std::vector<GLuint> welded_face;
+    welded_face.reserve(face.size());
+    for (size_t i = 0; i + 2 < face.size(); i += 3){
+        GLuint a = remap[face[i]], b = remap[face[i + 1]], c = remap[face[i + 2]];
+        if ((a != b) && (b != c) && (a != c)){
+            welded_face.push_back(a);
+            welded_face.push_back(b);
+            welded_face.push_back(c);
+        }
+    }
+
+    vertex.swap(welded);
+    face.swap(welded_face);
+}
+
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<GLuint> &face, size_t num_vertices){
+
+    size_t num_triangles = face.size() / 3;
+    if (num_triangles == 0){
+        return;
+    }
+
+    // Triangles using each vertex, stored in one array: those of vertex v
+    // start at offset[v], and the first remaining[v] of them are not
+    // drawn yet
+    std::vector<GLuint> offset(num_vertices + 1, 0);
+    for (size_t i = 0; i < face.size(); i++){
+        offset[face[i] + 1]++;
+    }
+    for (size_t v = 0; v < num_vertices; v++){
+        offset[v + 1] += offset[v];
+    }
+    std::vector<int> remaining(num_vertices);
+    for (size_t v = 0; v < num_vertices; v++){
+        remaining[v] = (int) (offset[v + 1] - offset[v]);
+    }
+    std::vector<GLuint> adjacency(face.size());
+    std::vector<GLuint> fill(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < face.size(); i++){
+        adjacency[fill[face[i]]++] = (GLuint) (i / 3);
+    }
+
+    // Scores of the vertices and triangles
+    std::vector<int> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; v++){
+        vertex_score[v] = VertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(num_triangles);
+    for (size_t t = 0; t < num_triangles; t++){
+        triangle_score[t] = vertex_score[face[3*t]] + vertex_score[face[3*t + 1]] + vertex_score[face[3*t + 2]];
+    }
+
+    std::vector<bool> drawn(num_triangles, false);
+    std::vector<GLuint> result;
+    result.reserve(face.size());
+    std::vector<GLuint> cache, new_cache;
+    size_t next = 0; // First triangle that may not be drawn yet
+    int best = -1;
+
+    while (result.size() < face.size()){
+        // Nothing left around the cache: start again from any triangle
+        if (best < 0){
+            while (drawn[next]){
+                next++;
+            }
+            best = (int) next;
+        }
+
+        // Draw the triangle, and remove it from the lists of its vertices
+        drawn[best] = true;
+        for (int k = 0; k < 3; k++){
+            GLuint v = face[3*best + k];
+            result.push_back(v);
+            GLuint *triangles = &adjacency[offset[v]];
+            for (int j = 0; j < remaining[v]; j++){
+                if (triangles[j] == (GLuint) best){
+                    std::swap(triangles[j], triangles[remaining[v] - 1]);
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // Its vertices move to the front of the cache, pushing the oldest
+        // ones out
+        new_cache.clear();
+        for (int k = 0; k < 3; k++){
+            new_cache.push_back(face[3*best + k]);
+        }
+        for (size_t i = 0; i < cache.size(); i++){
+            if (std::find(new_cache.begin(), new_cache.begin() + 3, cache[i]) == new_cache.begin() + 3){
+                new_cache.push_back(cache[i]);
+            }
+        }
+        for (size_t i = 0; i < new_cache.size(); i++){
+            cache_position[new_cache[i]] = (i < (size_t) cache_size_g) ? (int) i : -1;
+        }
+
+        // Update the scores of the vertices that moved, and of their
+        // triangles
+        for (size_t i = 0; i < new_cache.size(); i++){
+            GLuint v = new_cache[i];
+            float score = VertexScore(cache_position[v], remaining[v]);
+            float change = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (int j = 0; j < remaining[v]; j++){
+                triangle_score[adjacency[offset[v] + j]] += change;
+            }
+        }
+
+        // The next triangle is the best one using a vertex of the cache
+        if (new_cache.size() > (size_t) cache_size_g){
+            new_cache.resize(cache_size_g);
+        }
+        best = -1;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < new_cache.size(); i++){
+            GLuint v = new_cache[i];
+            for (int j = 0; j < remaining[v]; j++){
+                GLuint t = adjacency[offset[v] + j];
+                if (triangle_score[t] > best_score){
+                    best = (int) t;
+                    best_score = triangle_score[t];
+                }
+            }
+        }
+        cache.swap(new_cache);
+    }
+
+    face.swap(result);
+}
+
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<GLfloat> &vertex, std::vector<GLuint> &face){
+
+    size_t num_vertices = vertex.size() / UnpackedVertexSize;
+    std::vector<GLuint> remap(num_vertices, unused_vertex_g);
+    std::vector<GLfloat> ordered;
+    ordered.reserve(vertex.size());
+    for (size_t i = 0; i < face.size(); i++){
+        GLuint v = face[i];
+        if (remap[v] == unused_vertex_g){
+            remap[v] = (GLuint) (ordered.size() / UnpackedVertexSize);
+            ordered.insert(ordered.end(), vertex.begin() + v*UnpackedVertexSize, vertex.begin() + (v + 1)*UnpackedVertexSize);
+        }
+        face[i] = remap[v];
+    }
+    vertex.swap(ordered);
+}
+
+
+GLenum MeshOptimizer::GetIndexType(size_t num_vertices){
+
+    return (num_vertices <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+} // namespace game
@@ -0,0 +1,41 @@
+#ifndef MESH_OPTIMIZER_H_
+#define MESH_OPTIMIZER_H_
+
+#include <vector>
+#include <stddef.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace game {
+
+    // Rearranges triangle meshes so that the GPU draws them with fewer
+    // vertex shader runs and memory reads, without changing their look
+    // Meshes are given as unpacked vertices (11 floats each) and a list
+    // of triangles, three indices each
+    class MeshOptimizer {
+
+        public:
+            // Run all steps below, in order
+            static void Optimize(std::vector<GLfloat> &vertex, std::vector<GLuint> &face);
+
+            // Merge the vertices whose attributes are all identical, and
+            // remove the triangles left with a repeated vertex
+            static void WeldVertices(std::vector<GLfloat> &vertex, std::vector<GLuint> &face);
+            // Order the triangles so that consecutive ones share vertices,
+            // which then come from the post-transform cache (Forsyth's
+            // linear-speed algorithm)
+            static void OptimizeVertexCache(std::vector<GLuint> &face, size_t num_vertices);
+            // Order the vertices by first use, so that they are read from
+            // memory mostly sequentially; unused vertices are removed
+            static void OptimizeVertexFetch(std::vector<GLfloat> &vertex, std::vector<GLuint> &face);
+
+            // Smallest index type able to address the given number of
+            // vertices: GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+            static GLenum GetIndexType(size_t num_vertices);
+
+    }; // class MeshOptimizer
+
+} // namespace game
+
+#endif // MESH_OPTIMIZER_H_
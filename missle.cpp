@@ -7,6 +7,7 @@ namespace game {
 		forwardVelocity = forward;
 		lifeSpan = 300;
 		damage = 40;
+		trail = NULL;
 	}
 
 
@@ -19,6 +20,11 @@ namespace game {
 		velocity_ = velocity;
 	}
 
+	void Missle::SetTrail(ParticleSystem *particles) {
+
+		trail = particles;
+	}
+
 	void Missle::die() {
 		draw = false;
 
@@ -32,6 +38,9 @@ namespace game {
 		//position_ += velocity_;
 		velocity_ += forwardVelocity * 0.005f;
 		Translate(velocity_);
+
+		// A few slow puffs of smoke per frame
+		if (trail && draw) trail->Emit(GetPosition(), glm::vec3(0.0, 0.5, 0.0), 0.4f, 8, 1.0f, glm::vec4(0.8, 0.8, 0.8, 0.3));
 	}
 
 } // namespace game
@@ -13,6 +13,7 @@
 #include "resource.h"
 #include "scene_node.h"
 #include "bullet.h"
+#include "particle_system.h"
 
 namespace game {
 
@@ -28,6 +29,9 @@ namespace game {
 
 		void SetVelocity(glm::vec3 velocity);
 
+		// Leave a trail of smoke in 'particles' while flying
+		void SetTrail(ParticleSystem *particles);
+
 		// Update geometry configuration
 		void Update(void);
 
@@ -38,6 +42,8 @@ namespace game {
 		glm::vec3 velocity_; // Velocity of Missle
 		glm::vec3 forwardVelocity;
 
+		ParticleSystem *trail;
+
 	}; // class Missle
 
 } // namespace game
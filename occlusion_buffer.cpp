@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+
+#include "occlusion_buffer.h"
+
+namespace game {
+
+// Corners of a box are numbered with one bit per axis: x (1), y (2), z (4)
+// Each face is split in two triangles
+const int box_triangles_g[12][3] = {
+    {0, 2, 6}, {0, 6, 4}, // -x
+    {1, 3, 7}, {1, 7, 5}, // +x
+    {0, 1, 5}, {0, 5, 4}, // -y
+    {2, 3, 7}, {2, 7, 6}, // +y
+    {0, 1, 3}, {0, 3, 2}, // -z
+    {4, 5, 7}, {4, 7, 6}  // +z
+};
+
+
+OcclusionBuffer::OcclusionBuffer(void){
+
+    depth_.resize(width*height, 1.0f);
+    view_projection_ = glm::mat4(1.0);
+    near_clip_ = 0.0;
+}
+
+
+OcclusionBuffer::~OcclusionBuffer(){
+}
+
+
+void OcclusionBuffer::Clear(const glm::mat4 &view_projection, float near_clip){
+
+    std::fill(depth_.begin(), depth_.end(), 1.0f);
+    view_projection_ = view_projection;
+    near_clip_ = near_clip;
+}
+
+
+void OcclusionBuffer::AddOccluderBox(const glm::mat4 &world_matrix, glm::vec3 box_min, glm::vec3 box_max){
+
+    // Project the corners to window coordinates
+    glm::mat4 transf = view_projection_ * world_matrix;
+    glm::vec3 window[8];
+    bool in_front[8];
+    for (int i = 0; i < 8; i++){
+        glm::vec4 corner((i & 1) ? box_max.x : box_min.x,
+                         (i & 2) ? box_max.y : box_min.y,
+                         (i & 4) ? box_max.z : box_min.z, 1.0f);
+        glm::vec4 clip = transf * corner;
+        in_front[i] = (clip.w >= near_clip_);
+        if (in_front[i]){
+            window[i] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * width,
+                                  (clip.y / clip.w * 0.5f + 0.5f) * height,
+                                  clip.z / clip.w * 0.5f + 0.5f);
+        }
+    }
+
+    // Triangles crossing the near plane are left out rather than clipped,
+    // which can only make the occluder smaller
+    for (int i = 0; i < 12; i++){
+        const int *t = box_triangles_g[i];
+        if (in_front[t[0]] && in_front[t[1]] && in_front[t[2]]){
+            RasterizeTriangle(window[t[0]], window[t[1]], window[t[2]]);
+        }
+    }
+}
+
+
+void OcclusionBuffer::RasterizeTriangle(const glm::vec3 &v0, const glm::vec3 &in_v1, const glm::vec3 &in_v2){
+
+    // Order the vertices counter-clockwise, so that the edge functions are
+    // positive inside the triangle
+    float area = (in_v1.x - v0.x)*(in_v2.y - v0.y) - (in_v1.y - v0.y)*(in_v2.x - v0.x);
+    glm::vec3 v1 = in_v1;
+    glm::vec3 v2 = in_v2;
+    if (area < 0.0f){
+        std::swap(v1, v2);
+        area = -area;
+    }
+    if (area < 1e-6f){
+        return;
+    }
+
+    // Pixels covered by the bounding rectangle of the triangle
+    int min_x = std::max((int) std::floor(std::min(v0.x, std::min(v1.x, v2.x))), 0);
+    int max_x = std::min((int) std::ceil(std::max(v0.x, std::max(v1.x, v2.x))), width - 1);
+    int min_y = std::max((int) std::floor(std::min(v0.y, std::min(v1.y, v2.y))), 0);
+    int max_y = std::min((int) std::ceil(std::max(v0.y, std::max(v1.y, v2.y))), height - 1);
+    if ((min_x > max_x) || (min_y > max_y)){
+        return;
+    }
+
+    // Edge functions e(x, y) = a*x + b*y + c, one per edge, each named
+    // after the vertex opposite to it
+    float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x*v2.y - v2.x*v1.y;
+    float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x*v0.y - v0.x*v2.y;
+    float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x*v1.y - v1.x*v0.y;
+
+    // Depth is linear in window coordinates: interpolate it as a plane
+    float za = (a0*v0.z + a1*v1.z + a2*v2.z) / area;
+    float zb = (b0*v0.z + b1*v1.z + b2*v2.z) / area;
+    float zc = (c0*v0.z + c1*v1.z + c2*v2.z) / area;
+
+    // Start rows on a multiple of 4 pixels; the extra pixels fail the
+    // edge tests
+    min_x &= ~3;
+
+#ifdef OCCLUSION_BUFFER_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    for (int y = min_y; y <= max_y; y++){
+        float py = y + 0.5f;
+        float *row = &depth_[y*width];
+        for (int x = min_x; x <= max_x; x += 4){
+            // Centers of four consecutive pixels
+            __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(b0*py + c0));
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(b1*py + c1));
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(b2*py + c2));
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0){
+                continue;
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb*py + zc));
+            __m128 old_z = _mm_loadu_ps(row + x);
+            __m128 new_z = _mm_min_ps(old_z, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+        }
+    }
+#else
+    for (int y = min_y; y <= max_y; y++){
+        float py = y + 0.5f;
+        float *row = &depth_[y*width];
+        for (int x = min_x; x <= max_x; x++){
+            float px = x + 0.5f;
+            if ((a0*px + b0*py + c0 >= 0.0f) &&
+                (a1*px + b1*py + c1 >= 0.0f) &&
+                (a2*px + b2*py + c2 >= 0.0f)){
+                row[x] = std::min(row[x], za*px + zb*py + zc);
+            }
+        }
+    }
+#endif
+}
+
+
+bool OcclusionBuffer::IsBoxVisible(const glm::mat4 &world_matrix, glm::vec3 box_min, glm::vec3 box_max) const {
+
+    // Find the window rectangle covered by the box and its closest depth
+    glm::mat4 transf = view_projection_ * world_matrix;
+    float rect_min_x = (float) width, rect_max_x = 0.0f;
+    float rect_min_y = (float) height, rect_max_y = 0.0f;
+    float closest = 1.0f;
+    for (int i = 0; i < 8; i++){
+        glm::vec4 corner((i & 1) ? box_max.x : box_min.x,
+                         (i & 2) ? box_max.y : box_min.y,
+                         (i & 4) ? box_max.z : box_min.z, 1.0f);
+        glm::vec4 clip = transf * corner;
+        // Boxes reaching the camera cannot be hidden
+        if (!(clip.w >= near_clip_)){
+            return true;
+        }
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+        rect_min_x = std::min(rect_min_x, x);
+        rect_max_x = std::max(rect_max_x, x);
+        rect_min_y = std::min(rect_min_y, y);
+        rect_max_y = std::max(rect_max_y, y);
+        closest = std::min(closest, clip.z / clip.w * 0.5f + 0.5f);
+    }
+
+    int min_x = std::max((int) std::floor(rect_min_x), 0);
+    int max_x = std::min((int) std::floor(rect_max_x), width - 1);
+    int min_y = std::max((int) std::floor(rect_min_y), 0);
+    int max_y = std::min((int) std::floor(rect_max_y), height - 1);
+    if ((min_x > max_x) || (min_y > max_y)){
+        // Not on the screen: leave the decision to frustum culling
+        return true;
+    }
+
+    // The box is hidden if every pixel it covers holds a closer occluder
+    // Testing a few pixels beyond the rectangle keeps the test conservative
+    min_x &= ~3;
+
+#ifdef OCCLUSION_BUFFER_SSE2
+    const __m128 box_z = _mm_set1_ps(closest);
+    for (int y = min_y; y <= max_y; y++){
+        const float *row = &depth_[y*width];
+        for (int x = min_x; x <= max_x; x += 4){
+            if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), box_z))){
+                return true;
+            }
+        }
+    }
+#else
+    for (int y = min_y; y <= max_y; y++){
+        const float *row = &depth_[y*width];
+        for (int x = min_x; x <= max_x; x++){
+            if (row[x] >= closest){
+                return true;
+            }
+        }
+    }
+#endif
+
+    return false;
+}
+
+} // namespace game
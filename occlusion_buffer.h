@@ -0,0 +1,56 @@
+#ifndef OCCLUSION_BUFFER_H_
+#define OCCLUSION_BUFFER_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Use SSE2 when the compiler targets it; there is a scalar version of
+// every loop otherwise
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OCCLUSION_BUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace game {
+
+    // Low-resolution depth buffer filled on the CPU with a few large
+    // occluders, used to skip objects that are hidden behind them
+    // Depths are window depths in [0, 1], as in the OpenGL depth buffer
+    class OcclusionBuffer {
+
+        public:
+            // Resolution of the buffer; the width is a multiple of 4 so
+            // that rows can be processed 4 pixels at a time
+            static const int width = 256;
+            static const int height = 128;
+
+            OcclusionBuffer(void);
+            ~OcclusionBuffer();
+
+            // Clear the buffer for a new frame
+            // 'view_projection' maps world to clip coordinates; points
+            // closer than 'near_clip' are not considered
+            void Clear(const glm::mat4 &view_projection, float near_clip);
+
+            // Rasterize the box [box_min, box_max] placed in the world
+            // with 'world_matrix'
+            void AddOccluderBox(const glm::mat4 &world_matrix, glm::vec3 box_min, glm::vec3 box_max);
+
+            // Check whether any part of the box [box_min, box_max] placed
+            // in the world with 'world_matrix' may be visible
+            bool IsBoxVisible(const glm::mat4 &world_matrix, glm::vec3 box_min, glm::vec3 box_max) const;
+
+        private:
+            // Rasterize one triangle given in window coordinates (x, y in
+            // pixels, z depth), keeping the closest depth of each pixel
+            void RasterizeTriangle(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2);
+
+            std::vector<float> depth_; // Depth of each pixel, row by row
+            glm::mat4 view_projection_;
+            float near_clip_;
+
+    }; // class OcclusionBuffer
+
+} // namespace game
+
+#endif // OCCLUSION_BUFFER_H_
@@ -0,0 +1,142 @@
+#include <stdexcept>
+#include <string>
+#include <cstddef>
+
+#include "overlay.h"
+
+namespace game {
+
+Overlay::Overlay(void){
+
+    program_ = 0;
+    viewport_size_ = -1;
+    vertex_array_ = 0;
+    num_draws_ = 0;
+}
+
+
+Overlay::~Overlay(){
+}
+
+
+void Overlay::Init(const Resource *material){
+
+    if (!material || (material->GetType() != Material)){
+        throw(std::invalid_argument(std::string("Invalid material for the overlay")));
+    }
+    program_ = material->GetResource();
+    viewport_size_ = glGetUniformLocation(program_, "viewport_size");
+
+    // The vertices move within the stream buffer every frame: only the
+    // enabled attributes are recorded here
+    glGenVertexArrays(1, &vertex_array_);
+    glBindVertexArray(vertex_array_);
+    glEnableVertexAttribArray(VertexAttribute);
+    glEnableVertexAttribArray(ColorAttribute);
+    glEnableVertexAttribArray(UVAttribute);
+    glBindVertexArray(0);
+}
+
+
+void Overlay::Clear(void){
+
+    vertices_.clear();
+    runs_.clear();
+}
+
+
+size_t Overlay::GetNumDraws(void) const {
+
+    return num_draws_;
+}
+
+
+void Overlay::AddQuad(glm::vec2 min, glm::vec2 max, glm::vec4 color){
+
+    // Plain quads ignore the texture, so they join any run
+    if (runs_.empty()){
+        Run run = {(GLint) vertices_.size(), 0, 0, 0};
+        runs_.push_back(run);
+    }
+    AddVertices(min, max, color, 0.0f, 0.0f);
+}
+
+
+void Overlay::AddQuad(glm::vec2 min, glm::vec2 max, const Resource *texture, glm::vec4 color){
+
+    if (!texture){
+        AddQuad(min, max, color);
+        return;
+    }
+
+    // Start a new run only when the current one already uses another
+    // texture array
+    GLuint id = texture->GetResource();
+    if (runs_.empty() || (runs_.back().texture && (runs_.back().texture != id))){
+        Run run = {(GLint) vertices_.size(), 0, 0, 0};
+        runs_.push_back(run);
+    }
+    runs_.back().texture = id;
+    runs_.back().sampler = texture->GetSampler();
+    AddVertices(min, max, color, (float) texture->GetLayer(), 1.0f);
+}
+
+
+void Overlay::AddVertices(glm::vec2 min, glm::vec2 max, glm::vec4 color, float layer, float texture_weight){
+
+    // Two triangles; texture coordinates grow upwards, as on the meshes
+    // the images were made for
+    const glm::vec2 corner[6] = {
+        glm::vec2(0.0, 0.0), glm::vec2(1.0, 0.0), glm::vec2(1.0, 1.0),
+        glm::vec2(0.0, 0.0), glm::vec2(1.0, 1.0), glm::vec2(0.0, 1.0)
+    };
+    for (int i = 0; i < 6; i++){
+        Vertex vertex;
+        vertex.position = min + (max - min) * corner[i];
+        vertex.color = color;
+        vertex.uv = glm::vec4(corner[i], layer, texture_weight);
+        vertices_.push_back(vertex);
+    }
+    runs_.back().count += 6;
+}
+
+
+void Overlay::Draw(GLfloat width, GLfloat height, StreamBuffer *stream){
+
+    num_draws_ = 0;
+    if (vertices_.empty() || !program_){
+        return;
+    }
+
+    // Point the attributes at the vertices of the frame
+    GLintptr offset = stream->Upload(&vertices_[0], vertices_.size()*sizeof(Vertex));
+    glBindVertexArray(vertex_array_);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->GetBuffer());
+    glVertexAttribPointer(VertexAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) (offset + offsetof(Vertex, position)));
+    glVertexAttribPointer(ColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) (offset + offsetof(Vertex, color)));
+    glVertexAttribPointer(UVAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) (offset + offsetof(Vertex, uv)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(program_);
+    glUniform2f(viewport_size_, width, height);
+
+    // Quads cover the scene, and may be partly transparent
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glActiveTexture(GL_TEXTURE0);
+    for (size_t i = 0; i < runs_.size(); i++){
+        glBindTexture(GL_TEXTURE_2D_ARRAY, runs_[i].texture);
+        glBindSampler(0, runs_[i].sampler);
+        glDrawArrays(GL_TRIANGLES, runs_[i].first, runs_[i].count);
+        num_draws_++;
+    }
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
+    glBindSampler(0, 0);
+}
+
+} // namespace game
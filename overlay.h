@@ -0,0 +1,78 @@
+#ifndef OVERLAY_H_
+#define OVERLAY_H_
+
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "resource.h"
+#include "stream_buffer.h"
+
+namespace game {
+
+    // Screen-space quads drawn on top of the scene, such as the bars and
+    // panels of the HUD
+    // The quads of a frame are stored in the stream buffer and drawn
+    // in order with an orthographic projection, using one draw call for
+    // each change of texture array; plain quads and quads showing other
+    // layers of the same array never need a new call
+    class Overlay {
+
+        public:
+            Overlay(void);
+            ~Overlay();
+
+            // Set the shader program drawing the quads
+            // Call once an OpenGL context is available
+            void Init(const Resource *material);
+
+            // Remove all quads, before adding the ones of a new frame
+            void Clear(void);
+
+            // Add a quad of plain color; corners are in pixels from the
+            // lower-left corner of the viewport
+            void AddQuad(glm::vec2 min, glm::vec2 max, glm::vec4 color);
+            // Add a quad showing a texture, tinted by 'color'
+            void AddQuad(glm::vec2 min, glm::vec2 max, const Resource *texture, glm::vec4 color = glm::vec4(1.0));
+
+            // Draw the quads over the current frame, in the order they
+            // were added, for a viewport of the given size
+            // The vertices of the frame are uploaded to 'stream'
+            void Draw(GLfloat width, GLfloat height, StreamBuffer *stream);
+
+            // Number of draw calls issued by the last Draw
+            size_t GetNumDraws(void) const;
+
+        private:
+            // Layout of the vertex buffer
+            struct Vertex {
+                glm::vec2 position;
+                glm::vec4 color;
+                glm::vec4 uv; // Texture coordinates, layer, and weight of the texture
+            };
+
+            // Consecutive quads drawn with the same texture array
+            struct Run {
+                GLint first; // First vertex
+                GLsizei count; // Number of vertices
+                GLuint texture; // 0 while the run only holds plain quads
+                GLuint sampler;
+            };
+
+            // Add the two triangles of a quad to the current run
+            void AddVertices(glm::vec2 min, glm::vec2 max, glm::vec4 color, float layer, float texture_weight);
+
+            GLuint program_; // Shader program
+            GLint viewport_size_; // Location of the viewport size uniform
+            GLuint vertex_array_; // Layout of the vertices
+            std::vector<Vertex> vertices_;
+            std::vector<Run> runs_;
+            size_t num_draws_;
+
+    }; // class Overlay
+
+} // namespace game
+
+#endif // OVERLAY_H_
@@ -0,0 +1,19 @@
+#version 140
+
+// Attributes passed from the vertex shader
+in vec4 color_interp;
+in vec4 uv_interp;
+
+// Color of the fragment
+out vec4 frag_color;
+
+// Uniform (global) buffer
+uniform sampler2DArray texture_map;
+
+
+void main() 
+{
+    // Plain quads ignore the texture bound with the textured ones
+    vec4 pixel = texture(texture_map, uv_interp.xyz);
+    frag_color = color_interp * mix(vec4(1.0), pixel, uv_interp.w);
+}
@@ -0,0 +1,24 @@
+#version 140
+
+// Vertex buffer of the overlay, filled every frame
+in vec2 vertex; // Position in pixels from the lower-left corner
+in vec4 color;
+in vec4 uv; // Texture coordinates, layer, and weight of the texture (0 for plain quads)
+
+// Size of the viewport, in pixels
+uniform vec2 viewport_size;
+
+// Attributes forwarded to the fragment shader
+out vec4 color_interp;
+out vec4 uv_interp;
+
+
+void main()
+{
+    // Orthographic projection from pixels to [-1, 1]
+    gl_Position = vec4(vertex / viewport_size * 2.0 - 1.0, 0.0, 1.0);
+
+    color_interp = color;
+
+    uv_interp = uv;
+}
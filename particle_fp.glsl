@@ -0,0 +1,19 @@
+#version 140
+
+// Attributes passed from the vertex shader
+in vec4 color_interp;
+
+// Color of the fragment
+out vec4 frag_color;
+
+
+void main() 
+{
+    // Round sprite, fading towards its border
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    float distance = dot(offset, offset);
+    if (distance > 1.0){
+        discard;
+    }
+    frag_color = vec4(color_interp.rgb, color_interp.a * (1.0 - distance));
+}
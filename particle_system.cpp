@@ -0,0 +1,216 @@
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cstddef>
+
+#include "particle_system.h"
+
+namespace game {
+
+// Longest simulation step, so that pauses do not make particles jump
+const float max_step_g = 0.1;
+
+// Size of a new particle, in world units
+const float particle_size_g = 0.3;
+
+
+ParticleSystem::ParticleSystem(void){
+
+    update_program_ = 0;
+    draw_program_ = 0;
+    point_size_ = -1;
+    point_scale_ = -1;
+    point_sprite_ = false;
+    array_buffer_[0] = array_buffer_[1] = 0;
+    vertex_array_[0] = vertex_array_[1] = 0;
+    current_ = 0;
+    num_particles_ = 0;
+    next_ = 0;
+    clock_ = 0.0;
+    last_time_ = -1.0;
+    alive_until_ = 0.0;
+    frame_ = 0;
+}
+
+
+ParticleSystem::~ParticleSystem(){
+}
+
+
+void ParticleSystem::Init(const Resource *update_material, const Resource *draw_material, int num_particles){
+
+    if (!update_material || (update_material->GetType() != Material) ||
+        !draw_material || (draw_material->GetType() != Material)){
+        throw(std::invalid_argument(std::string("Invalid materials for the particle system")));
+    }
+    if (num_particles <= 0){
+        throw(std::invalid_argument(std::string("Invalid number of particles")));
+    }
+
+    update_program_ = update_material->GetResource();
+    draw_program_ = draw_material->GetResource();
+    num_particles_ = num_particles;
+
+    update_locations_.num_emitters = glGetUniformLocation(update_program_, "num_emitters");
+    update_locations_.emitter_range = glGetUniformLocation(update_program_, "emitter_range");
+    update_locations_.emitter_position = glGetUniformLocation(update_program_, "emitter_position");
+    update_locations_.emitter_velocity = glGetUniformLocation(update_program_, "emitter_velocity");
+    update_locations_.emitter_color = glGetUniformLocation(update_program_, "emitter_color");
+    update_locations_.num_particles = glGetUniformLocation(update_program_, "num_particles");
+    update_locations_.delta_time = glGetUniformLocation(update_program_, "delta_time");
+    update_locations_.seed = glGetUniformLocation(update_program_, "seed");
+    point_size_ = glGetUniformLocation(draw_program_, "point_size");
+    point_scale_ = glGetUniformLocation(draw_program_, "point_scale");
+
+    // Core profiles always generate point sprite coordinates
+    GLint profile = 0;
+    glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+    glGetError(); // The query fails before OpenGL 3.2
+    point_sprite_ = !(profile & GL_CONTEXT_CORE_PROFILE_BIT);
+
+    // All particles start dead, with age and lifetime 0
+    std::vector<Particle> particles(num_particles_);
+    glGenBuffers(2, array_buffer_);
+    glGenVertexArrays(2, vertex_array_);
+    for (int i = 0; i < 2; i++){
+        glBindBuffer(GL_ARRAY_BUFFER, array_buffer_[i]);
+        glBufferData(GL_ARRAY_BUFFER, particles.size()*sizeof(Particle), &particles[0], GL_DYNAMIC_COPY);
+
+        // Same attributes as the meshes, with the velocity as the normal
+        // and the age as the texture coordinates
+        glBindVertexArray(vertex_array_[i]);
+        glVertexAttribPointer(VertexAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *) offsetof(Particle, position));
+        glEnableVertexAttribArray(VertexAttribute);
+        glVertexAttribPointer(NormalAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *) offsetof(Particle, velocity));
+        glEnableVertexAttribArray(NormalAttribute);
+        glVertexAttribPointer(ColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *) offsetof(Particle, color));
+        glEnableVertexAttribArray(ColorAttribute);
+        glVertexAttribPointer(UVAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *) offsetof(Particle, age));
+        glEnableVertexAttribArray(UVAttribute);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void ParticleSystem::Emit(glm::vec3 position, glm::vec3 velocity, float spread, int count, float lifetime, glm::vec4 color){
+
+    if (!num_particles_ || (count <= 0)){
+        return;
+    }
+    count = std::min(count, num_particles_);
+
+    Emitter emitter;
+    emitter.first = next_;
+    emitter.count = count;
+    emitter.position = glm::vec4(position, spread);
+    emitter.velocity = glm::vec4(velocity, lifetime);
+    emitter.color = color;
+    emitters_.push_back(emitter);
+
+    next_ = (next_ + count) % num_particles_;
+    // Lifetimes vary by up to 25% in the shader
+    alive_until_ = std::max(alive_until_, clock_ + 1.25f*lifetime + max_step_g);
+}
+
+
+void ParticleSystem::Update(float time){
+
+    float delta_time = (last_time_ < 0.0) ? 0.0f : std::min(std::max(time - last_time_, 0.0f), max_step_g);
+    last_time_ = time;
+    clock_ += delta_time;
+
+    // Nothing to simulate once all particles are dead
+    if (emitters_.empty() && (clock_ >= alive_until_)){
+        return;
+    }
+
+    // Emitters beyond the first pass are added without moving the
+    // particles again
+    Simulate(delta_time, 0);
+    for (size_t i = max_emitters; i < emitters_.size(); i += max_emitters){
+        Simulate(0.0, i);
+    }
+    emitters_.clear();
+    frame_++;
+}
+
+
+void ParticleSystem::Simulate(float delta_time, size_t first_emitter){
+
+    // Gather the emitters of the pass
+    int num_emitters = (int) std::min(emitters_.size() - std::min(first_emitter, emitters_.size()), (size_t) max_emitters);
+    GLint range[2*max_emitters];
+    glm::vec4 position[max_emitters], velocity[max_emitters], color[max_emitters];
+    for (int i = 0; i < num_emitters; i++){
+        const Emitter &emitter = emitters_[first_emitter + i];
+        range[2*i] = emitter.first;
+        range[2*i + 1] = emitter.count;
+        position[i] = emitter.position;
+        velocity[i] = emitter.velocity;
+        color[i] = emitter.color;
+    }
+
+    glUseProgram(update_program_);
+    glUniform1i(update_locations_.num_emitters, num_emitters);
+    if (num_emitters > 0){
+        glUniform2iv(update_locations_.emitter_range, num_emitters, range);
+        glUniform4fv(update_locations_.emitter_position, num_emitters, &position[0][0]);
+        glUniform4fv(update_locations_.emitter_velocity, num_emitters, &velocity[0][0]);
+        glUniform4fv(update_locations_.emitter_color, num_emitters, &color[0][0]);
+    }
+    glUniform1i(update_locations_.num_particles, num_particles_);
+    glUniform1f(update_locations_.delta_time, delta_time);
+    glUniform1ui(update_locations_.seed, (GLuint) (frame_*max_emitters + first_emitter) * 2654435761u);
+
+    // Read the current buffer and write the other one, without drawing
+    int next = 1 - current_;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(vertex_array_[current_]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, array_buffer_[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, num_particles_);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    current_ = next;
+}
+
+
+void ParticleSystem::Draw(Camera *camera){
+
+    if (!num_particles_ || (clock_ >= alive_until_)){
+        return;
+    }
+
+    glUseProgram(draw_program_);
+    glUniform1f(point_size_, particle_size_g);
+    // Points are sized in pixels of the target drawn into, which may be
+    // smaller than the viewport of the camera
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glUniform1f(point_scale_, camera->GetProjectionMatrix()[1][1] * viewport[3] * 0.5f);
+
+    // Particles glow over the scene and do not hide each other
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    if (point_sprite_){
+        glEnable(GL_POINT_SPRITE);
+    }
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glDepthMask(GL_FALSE);
+
+    glBindVertexArray(vertex_array_[current_]);
+    glDrawArrays(GL_POINTS, 0, num_particles_);
+    glBindVertexArray(0);
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    if (point_sprite_){
+        glDisable(GL_POINT_SPRITE);
+    }
+    glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
+} // namespace game
@@ -0,0 +1,106 @@
+#ifndef PARTICLE_SYSTEM_H_
+#define PARTICLE_SYSTEM_H_
+
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "resource.h"
+#include "camera.h"
+
+namespace game {
+
+    // Particles simulated entirely on the GPU, such as explosions and
+    // missile trails
+    // The particles live in a ring of fixed size stored twice: every frame
+    // a transform feedback pass reads one buffer and writes the other, so
+    // the CPU only describes the emitters and never touches a particle
+    class ParticleSystem {
+
+        public:
+            // Most emitters handled by one simulation pass
+            // Keep in sync with particle_update_vp.glsl
+            static const int max_emitters = 64;
+
+            ParticleSystem(void);
+            ~ParticleSystem();
+
+            // Create the particle buffers; 'update_material' simulates the
+            // particles and 'draw_material' renders them as point sprites
+            // Call once an OpenGL context is available
+            void Init(const Resource *update_material, const Resource *draw_material, int num_particles = 65536);
+
+            // Create 'count' particles at 'position' in the next update,
+            // moving at 'velocity' plus a random velocity of up to
+            // 'spread', and living about 'lifetime' seconds
+            // The oldest particles are replaced when the ring is full
+            void Emit(glm::vec3 position, glm::vec3 velocity, float spread, int count, float lifetime, glm::vec4 color);
+
+            // Advance the simulation to 'time', in seconds, and create the
+            // particles emitted since the last update
+            void Update(float time);
+
+            // Draw the particles; the per-frame uniform block must already
+            // be bound
+            void Draw(Camera *camera);
+
+        private:
+            // Layout of the particle buffers, matching the shader inputs
+            struct Particle {
+                glm::vec3 position;
+                glm::vec3 velocity;
+                glm::vec4 color;
+                glm::vec2 age; // Age and lifetime, in seconds
+            };
+
+            // Particles created by one call to Emit
+            struct Emitter {
+                GLint first; // First particle of the range in the ring
+                GLint count;
+                glm::vec4 position; // Position and spread
+                glm::vec4 velocity; // Velocity and lifetime
+                glm::vec4 color;
+            };
+
+            // Locations of the uniforms of the simulation program
+            struct UpdateLocations {
+                GLint num_emitters;
+                GLint emitter_range;
+                GLint emitter_position;
+                GLint emitter_velocity;
+                GLint emitter_color;
+                GLint num_particles;
+                GLint delta_time;
+                GLint seed;
+            };
+
+            // Run one simulation pass with up to max_emitters emitters
+            // starting at 'first_emitter'
+            void Simulate(float delta_time, size_t first_emitter);
+
+            GLuint update_program_;
+            GLuint draw_program_;
+            UpdateLocations update_locations_;
+            GLint point_size_; // Locations of the uniforms of the drawing
+            GLint point_scale_; // program
+            bool point_sprite_; // Whether point sprites must be enabled
+            GLuint array_buffer_[2]; // Ring of particles, twice
+            GLuint vertex_array_[2]; // Layout of each buffer
+            int current_; // Buffer holding the particles of this frame
+            int num_particles_;
+            int next_; // Next particle of the ring to be replaced
+            std::vector<Emitter> emitters_; // Emitters of the next update
+            float clock_; // Simulated time
+            float last_time_; // Time of the last update (negative before)
+            float alive_until_; // Time at which every particle is dead
+            unsigned frame_; // Number of updates, used to seed the random numbers
+
+    }; // class ParticleSystem
+
+} // namespace game
+
+#endif // PARTICLE_SYSTEM_H_
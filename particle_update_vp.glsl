@@ -0,0 +1,94 @@
+#version 140
+
+// Particle buffer: each vertex is one particle, read from one buffer and
+// written to the other with transform feedback
+in vec3 vertex; // Position
+in vec3 normal; // Velocity
+in vec4 color;
+in vec2 uv; // Age and lifetime, in seconds; dead once the age reaches the lifetime
+
+// Emitters of the frame, each filling a range of the ring of particles
+// Keep the size in sync with ParticleSystem::max_emitters
+const int max_emitters = 64;
+uniform int num_emitters;
+uniform ivec2 emitter_range[max_emitters]; // First particle and number of particles
+uniform vec4 emitter_position[max_emitters]; // Position, and spread of the velocities
+uniform vec4 emitter_velocity[max_emitters]; // Mean velocity, and lifetime
+uniform vec4 emitter_color[max_emitters];
+
+uniform int num_particles; // Size of the ring
+uniform float delta_time;
+uniform uint seed; // Changes every frame
+
+// Forces acting on every particle
+const vec3 gravity = vec3(0.0, -4.0, 0.0);
+const float drag = 1.5; // Fraction of the velocity lost per second
+
+// Particle written to the other buffer
+out vec3 position_out;
+out vec3 velocity_out;
+out vec4 color_out;
+out vec2 uv_out;
+
+
+// Integer hash, so that every particle gets its own random numbers
+uint Hash(uint x)
+{
+    x ^= x >> 16u;
+    x *= 0x7feb352du;
+    x ^= x >> 15u;
+    x *= 0x846ca68bu;
+    x ^= x >> 16u;
+    return x;
+}
+
+
+float Random(inout uint state)
+{
+    state = Hash(state);
+    return float(state) / 4294967295.0;
+}
+
+
+void main()
+{
+    position_out = vertex;
+    velocity_out = normal;
+    color_out = color;
+    uv_out = uv;
+
+    // Find the emitter creating this particle, if any
+    int emitter = -1;
+    for (int i = 0; i < num_emitters; i++){
+        int offset = gl_VertexID - emitter_range[i].x;
+        if (offset < 0){
+            offset += num_particles;
+        }
+        if (offset < emitter_range[i].y){
+            emitter = i;
+        }
+    }
+
+    if (emitter >= 0){
+        uint state = seed ^ Hash(uint(gl_VertexID));
+
+        // Random direction in a ball, as in the particle sets of the
+        // resource manager
+        float theta = Random(state) * 2.0 * 3.1415926;
+        float phi = acos(2.0 * Random(state) - 1.0);
+        float spray = pow(Random(state), 1.0 / 3.0);
+        vec3 direction = spray * vec3(cos(theta)*sin(phi), sin(theta)*sin(phi), cos(phi));
+
+        velocity_out = emitter_velocity[emitter].xyz + direction * emitter_position[emitter].w;
+        // Spread the new particles over the frame, so that moving emitters
+        // leave a continuous trail
+        float age = Random(state) * delta_time;
+        position_out = emitter_position[emitter].xyz + velocity_out * age;
+        color_out = emitter_color[emitter];
+        uv_out = vec2(age, emitter_velocity[emitter].w * (0.75 + 0.5 * Random(state)));
+    } else if (uv.x < uv.y){
+        velocity_out = (normal + gravity * delta_time) * max(1.0 - drag * delta_time, 0.0);
+        position_out = vertex + velocity_out * delta_time;
+        uv_out.x = uv.x + delta_time;
+    }
+}
@@ -0,0 +1,42 @@
+#version 140
+
+// Particle buffer
+in vec3 vertex; // Position
+in vec4 color;
+in vec2 uv; // Age and lifetime, in seconds
+
+// Per-frame uniform buffer, shared by all programs
+// Keep in sync with FrameBlock in frame_uniforms.h
+layout(std140) uniform FrameBlock {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    vec4 light_position;
+    float timer;
+};
+
+uniform float point_size; // Size of a new particle, in world units
+uniform float point_scale; // Size in pixels of one unit seen at unit distance
+
+// Attributes forwarded to the fragment shader
+out vec4 color_interp;
+
+
+void main()
+{
+    // Dead particles are left out of the view volume
+    if (uv.x >= uv.y){
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        color_interp = vec4(0.0);
+        return;
+    }
+
+    vec4 position = view_mat * vec4(vertex, 1.0);
+    gl_Position = projection_mat * position;
+
+    // Particles grow and fade as they age
+    float life = uv.x / uv.y;
+    gl_PointSize = point_size * (1.0 + life) * point_scale / max(-position.z, 0.01);
+    color_interp = vec4(color.rgb, color.a * (1.0 - life));
+}
@@ -0,0 +1,184 @@
+#include <stdexcept>
+#include <algorithm>
+#include <stack>
+#include <cfloat>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "prefab_mesh.h"
+#include "vertex_format.h"
+
+namespace game {
+
+// Transformation of a node relative to its parent, without scaling, as
+// passed down to its children
+static glm::mat4 GetLocalTransform(const SceneNode *node){
+
+    return glm::translate(glm::mat4(1.0), node->GetPosition()) * glm::mat4_cast(node->GetOrientation());
+}
+
+
+PrefabMesh::PrefabMesh(void){
+
+    geometry_ = NULL;
+    material_ = NULL;
+}
+
+
+PrefabMesh::~PrefabMesh(){
+}
+
+
+void PrefabMesh::Bake(ResourceManager *resman, const std::string &name, const Resource *material, const SceneNode *prefab, const std::vector<const SceneNode *> &animated){
+
+    if (!material || (material->GetType() != Material)){
+        throw(std::invalid_argument(std::string("Invalid material for prefab ")+name));
+    }
+    parts_.clear();
+
+    // Node to bake, with its part and its transformation to the frame of
+    // the part
+    struct Entry {
+        const SceneNode *node;
+        int part;
+        glm::mat4 transf;
+    };
+
+    std::vector<GLfloat> vertex;
+    std::vector<GLuint> face;
+    // Bounds of the parts that do not move, and spheres swept by the
+    // others, in the frame of the root
+    glm::vec3 box_min(FLT_MAX), box_max(-FLT_MAX);
+    std::vector<glm::vec4> swept;
+
+    std::stack<Entry> stck;
+    Entry root = {prefab, 0, glm::mat4(1.0)};
+    stck.push(root);
+    while (!stck.empty()){
+        Entry current = stck.top();
+        stck.pop();
+        const SceneNode *node = current.node;
+        if (!node->IsVisible()){
+            continue;
+        }
+        if (node->GetTexture() != prefab->GetTexture()){
+            throw(std::invalid_argument(std::string("Parts of prefab ")+name+std::string(" use different textures")));
+        }
+
+        // Vertices, scaled, in the frame of the part
+        const std::vector<GLfloat> &data = node->GetGeometry()->GetVertexData();
+        const std::vector<GLuint> &faces = node->GetGeometry()->GetFaceData();
+        GLuint first = (GLuint) (vertex.size() / UnpackedVertexSize);
+        glm::vec3 scale = node->GetScale();
+        glm::mat3 rotation(current.transf);
+        GLfloat layer = (node == prefab) ? -1.0f : (GLfloat) node->GetLayer();
+        float radius = 0.0f;
+        for (size_t i = 0; i < data.size(); i += UnpackedVertexSize){
+            glm::vec3 position(current.transf * glm::vec4(scale * glm::vec3(data[i + PositionOffset], data[i + PositionOffset + 1], data[i + PositionOffset + 2]), 1.0));
+            glm::vec3 normal = glm::normalize(rotation * (glm::vec3(data[i + NormalOffset], data[i + NormalOffset + 1], data[i + NormalOffset + 2]) / scale));
+            GLfloat baked[UnpackedVertexSize] = {
+                position.x, position.y, position.z,
+                normal.x, normal.y, normal.z,
+                (GLfloat) current.part, layer, 0.0f,
+                data[i + UVOffset], data[i + UVOffset + 1]
+            };
+            vertex.insert(vertex.end(), baked, baked + UnpackedVertexSize);
+
+            if (current.part == 0){
+                box_min = glm::min(box_min, position);
+                box_max = glm::max(box_max, position);
+            } else {
+                radius = std::max(radius, glm::length(position));
+            }
+        }
+        for (size_t i = 0; i < faces.size(); i++){
+            face.push_back(first + faces[i]);
+        }
+        if (current.part > 0){
+            const Part &part = parts_[current.part - 1];
+            glm::vec3 center(part.base * GetLocalTransform(part.node)[3]);
+            swept.push_back(glm::vec4(center, radius));
+        }
+
+        // Animated children start parts of their own
+        for (std::vector<SceneNode *>::const_iterator it = node->children_begin(); it != node->children_end(); it++){
+            Entry child = {*it, current.part, current.transf * GetLocalTransform(*it)};
+            if (std::find(animated.begin(), animated.end(), *it) != animated.end()){
+                if (current.part != 0){
+                    throw(std::invalid_argument(std::string("Animated node ")+(*it)->GetName()+std::string(" hangs from a moving part of prefab ")+name));
+                }
+                Part part = {*it, current.transf};
+                parts_.push_back(part);
+                child.part = (int) parts_.size();
+                child.transf = glm::mat4(1.0);
+            }
+            stck.push(child);
+        }
+    }
+
+    // The parts carry their layer instead of the color
+    const VertexLayout *layout = resman->GetVertexFormat();
+    if (PackedVertexFormatsSupported()){
+        resman->SetVertexFormat(GetVertexLayout<PackedPartVertexFormat>());
+    } else {
+        resman->SetVertexFormat(GetVertexLayout<FloatPartVertexFormat>());
+    }
+    Resource *geometry = resman->CreateMesh(name, vertex, face);
+    resman->SetVertexFormat(layout);
+
+    // Bounds holding the animated parts wherever they turn
+    for (size_t i = 0; i < swept.size(); i++){
+        box_min = glm::min(box_min, glm::vec3(swept[i]) - swept[i].w);
+        box_max = glm::max(box_max, glm::vec3(swept[i]) + swept[i].w);
+    }
+    glm::vec3 center = 0.5f*(box_min + box_max);
+    float radius = 0.0f;
+    for (size_t i = 0; i < vertex.size(); i += UnpackedVertexSize){
+        if (vertex[i + ColorOffset] == 0.0f){
+            radius = std::max(radius, glm::length(glm::vec3(vertex[i], vertex[i + 1], vertex[i + 2]) - center));
+        }
+    }
+    for (size_t i = 0; i < swept.size(); i++){
+        radius = std::max(radius, glm::length(glm::vec3(swept[i]) - center) + swept[i].w);
+    }
+    geometry->SetBoundingBox(box_min, box_max);
+    geometry->SetBoundingSphere(center, radius);
+
+    geometry_ = geometry;
+    material_ = material;
+    orientation_ = prefab->GetOrientation();
+}
+
+
+const Resource *PrefabMesh::GetGeometry(void) const {
+
+    return geometry_;
+}
+
+
+const Resource *PrefabMesh::GetMaterial(void) const {
+
+    return material_;
+}
+
+
+glm::quat PrefabMesh::GetOrientation(void) const {
+
+    return orientation_;
+}
+
+
+GLsizei PrefabMesh::GetPaletteSize(void) const {
+
+    return (GLsizei) parts_.size();
+}
+
+
+void PrefabMesh::GetPalette(glm::mat4 *palette) const {
+
+    for (size_t i = 0; i < parts_.size(); i++){
+        palette[i] = parts_[i].base * GetLocalTransform(parts_[i].node);
+    }
+}
+
+} // namespace game
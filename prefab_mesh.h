@@ -0,0 +1,72 @@
+#ifndef PREFAB_MESH_H_
+#define PREFAB_MESH_H_
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "resource.h"
+#include "resource_manager.h"
+#include "scene_node.h"
+
+namespace game {
+
+    // Prefab made of many nodes, such as a vehicle built from boxes,
+    // baked into a single mesh so that each instance is one node and one
+    // draw item instead of one per part
+    // Each vertex carries the part of the prefab it belongs to: part 0
+    // holds the nodes that never move relative to the root, and each
+    // animated node gets a part of its own, moved by a palette of
+    // matrices, one per animated node, that instances send along with
+    // their draw item
+    // Vertices also carry their texture layer, except those of the root,
+    // which read the layer of the node drawing the prefab so that its skin
+    // can still change
+    class PrefabMesh {
+
+        public:
+            PrefabMesh(void);
+            ~PrefabMesh();
+
+            // Merge the visible subtree of 'prefab' into the mesh 'name',
+            // drawn with 'material' (the prefab shaders)
+            // The nodes in 'animated', with their children, keep following
+            // their own position and orientation, and may turn freely about
+            // their origin; they must hang from nodes that do not move
+            // All nodes must use the same texture array
+            void Bake(ResourceManager *resman, const std::string &name, const Resource *material, const SceneNode *prefab, const std::vector<const SceneNode *> &animated);
+
+            const Resource *GetGeometry(void) const;
+            const Resource *GetMaterial(void) const;
+            // Orientation of the root of the prefab when baked
+            glm::quat GetOrientation(void) const;
+
+            // Number of matrices in the palette
+            GLsizei GetPaletteSize(void) const;
+            // Fill 'palette' with the current transformation of each
+            // animated node relative to the root
+            void GetPalette(glm::mat4 *palette) const;
+
+        private:
+            // Animated node, and transformation from the node it hangs
+            // from to the root
+            struct Part {
+                const SceneNode *node;
+                glm::mat4 base;
+            };
+
+            const Resource *geometry_;
+            const Resource *material_;
+            glm::quat orientation_;
+            std::vector<Part> parts_;
+
+    }; // class PrefabMesh
+
+} // namespace game
+
+#endif // PREFAB_MESH_H_
@@ -0,0 +1,66 @@
+#version 140
+
+// Vertex buffer
+in vec3 vertex;
+in vec3 normal;
+in vec2 uv;
+in vec2 part; // Part of the prefab, and texture layer (negative for the
+              // layer of the instance)
+
+// Instance buffer, one entry per drawn prefab
+in mat4 world_mat;
+in mat4 normal_mat;
+in float layer;
+in float palette; // First texel of the palette of the instance
+
+// Per-frame uniform buffer, shared by all programs
+// Keep in sync with FrameBlock in frame_uniforms.h
+layout(std140) uniform FrameBlock {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    vec4 light_position;
+    float timer;
+};
+
+// Transformations of the moving parts of the instances, one column per
+// texel; part 0 never moves and has none
+uniform samplerBuffer palette_map;
+
+// Attributes forwarded to the fragment shader
+out vec3 position_interp;
+out vec3 normal_interp;
+out vec4 color_interp;
+out vec2 uv_interp;
+flat out float layer_interp;
+out vec3 light_pos;
+
+
+void main()
+{
+    mat4 part_mat = mat4(1.0);
+    int index = int(part.x);
+    if (index > 0){
+        int texel = int(palette) + 4*(index - 1);
+        part_mat = mat4(texelFetch(palette_map, texel),
+                        texelFetch(palette_map, texel + 1),
+                        texelFetch(palette_map, texel + 2),
+                        texelFetch(palette_map, texel + 3));
+    }
+
+    vec4 position = world_mat * (part_mat * vec4(vertex, 1.0));
+    gl_Position = view_projection_mat * position;
+
+    position_interp = vec3(view_mat * position);
+
+    // Parts only move and turn: their matrix transforms the normals too
+    normal_interp = vec3(normal_mat * (part_mat * vec4(normal, 0.0)));
+
+    color_interp = vec4(1.0);
+
+    uv_interp = uv;
+
+    layer_interp = (part.y < 0.0) ? layer : part.y;
+
+    light_pos = vec3(view_mat * light_position);
+}
@@ -0,0 +1,135 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "program_cache.h"
+#include "hash.h"
+
+namespace game {
+
+// Tag at the start of every cache entry
+const char program_magic_g[4] = {'P', 'R', 'G', '1'};
+
+
+ProgramCache::ProgramCache(void){
+}
+
+
+ProgramCache::~ProgramCache(){
+}
+
+
+void ProgramCache::SetDirectory(const std::string &directory){
+
+    directory_ = directory;
+}
+
+
+const std::string &ProgramCache::GetDirectory(void) const {
+
+    return directory_;
+}
+
+
+bool ProgramCache::IsEnabled(void) const {
+
+    if (directory_.empty() || !(GLEW_ARB_get_program_binary || GLEW_VERSION_4_1)){
+        return false;
+    }
+
+    // Drivers may support the calls without any format to save to
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    return num_formats > 0;
+}
+
+
+uint64_t ProgramCache::MakeKey(const std::vector<std::string> &sources){
+
+    uint64_t hash = hash_offset_g;
+    for (size_t i = 0; i < sources.size(); i++){
+        hash = HashString(sources[i], hash);
+    }
+
+    // A driver update invalidates the binaries
+    const GLenum strings[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (int i = 0; i < 3; i++){
+        const char *str = (const char *) glGetString(strings[i]);
+        hash = HashString(str ? str : "", hash);
+    }
+    return hash;
+}
+
+
+std::string ProgramCache::GetPath(uint64_t key) const {
+
+    std::stringstream ss;
+    ss << directory_ << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return ss.str();
+}
+
+
+bool ProgramCache::Load(uint64_t key, GLuint program) const {
+
+    if (!IsEnabled()){
+        return false;
+    }
+
+    std::ifstream f(GetPath(key).c_str(), std::ios::binary);
+    if (f.fail()){
+        return false;
+    }
+
+    char magic[4];
+    uint32_t format, length;
+    f.read(magic, 4);
+    f.read((char *) &format, sizeof(format));
+    f.read((char *) &length, sizeof(length));
+    if (f.fail() || !std::equal(magic, magic + 4, program_magic_g) || (length == 0)){
+        return false;
+    }
+    std::vector<char> binary(length);
+    f.read(&binary[0], length);
+    if (f.fail()){
+        return false;
+    }
+
+    // The driver checks the binary, and refuses it if it came from another
+    // version
+    glProgramBinary(program, format, &binary[0], (GLsizei) length);
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+
+void ProgramCache::Save(uint64_t key, GLuint program) const {
+
+    if (!IsEnabled()){
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0){
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+    // The cache only saves time: a program that cannot be written is
+    // linked again on the next run
+    std::ofstream f(GetPath(key).c_str(), std::ios::binary);
+    if (f.fail()){
+        return;
+    }
+    uint32_t format_out = format, length_out = (uint32_t) length;
+    f.write(program_magic_g, 4);
+    f.write((const char *) &format_out, sizeof(format_out));
+    f.write((const char *) &length_out, sizeof(length_out));
+    f.write(&binary[0], length);
+}
+
+} // namespace game
@@ -0,0 +1,48 @@
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace game {
+
+    // Keeps linked shader programs in a directory, in the binary form of
+    // the driver, so that later runs skip compiling and linking them
+    // Binaries only work with the driver that produced them: entries are
+    // named after a hash of the program sources and of the driver strings
+    class ProgramCache {
+
+        public:
+            ProgramCache(void);
+            ~ProgramCache();
+
+            // Directory holding the programs; nothing is stored while it
+            // is empty or when the driver cannot save programs
+            void SetDirectory(const std::string &directory);
+            const std::string &GetDirectory(void) const;
+            bool IsEnabled(void) const;
+
+            // Key of a program built from the given sources and settings
+            static uint64_t MakeKey(const std::vector<std::string> &sources);
+
+            // Load the program saved under 'key' into 'program'
+            // Returns false if there is no entry, or if the driver rejects
+            // it; 'program' then needs to be linked from source
+            bool Load(uint64_t key, GLuint program) const;
+            // Save a linked program under 'key'
+            void Save(uint64_t key, GLuint program) const;
+
+        private:
+            std::string GetPath(uint64_t key) const;
+
+            std::string directory_;
+
+    }; // class ProgramCache
+
+} // namespace game
+
+#endif // PROGRAM_CACHE_H_
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <stddef.h>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/type_ptr.hpp>
+
+#include "render_queue.h"
+
+namespace game {
+
+// Number of bits of the sort key used by each state
+// Most significant first: pass, program, texture, mesh, depth; the pass
+// takes the top bits of the program, and is only there in GPU_PROFILER
+// builds, where each pass is measured on its own
+const int key_bits_g = 16;
+const int pass_bits_g = 4;
+const uint64_t key_mask_g = (1 << key_bits_g) - 1;
+const uint64_t program_mask_g = (1 << (key_bits_g - pass_bits_g)) - 1;
+
+// Names of the passes, in order
+const char *pass_names_g[NumDrawPasses] = {"Ground", "Buildings", "Enemies", "Objects"};
+
+
+RenderQueue::RenderQueue(void){
+
+    palette_map_ = 0;
+    palette_buffer_ = 0;
+    palette_range_ = false;
+    palette_alignment_ = 0;
+    max_palette_texels_ = 0;
+    num_batches_ = 0;
+}
+
+
+RenderQueue::~RenderQueue(){
+}
+
+
+void RenderQueue::Clear(void){
+
+    items_.clear();
+    order_.clear();
+    instances_.clear();
+}
+
+
+void RenderQueue::Add(const DrawItem &item){
+
+    SortEntry entry;
+    entry.key = item.key;
+    entry.index = (GLuint) items_.size();
+
+    items_.push_back(item);
+    order_.push_back(entry);
+}
+
+
+void RenderQueue::Append(const RenderQueue &other){
+
+    items_.reserve(items_.size() + other.items_.size());
+    order_.reserve(order_.size() + other.order_.size());
+    for (size_t i = 0; i < other.items_.size(); i++){
+        Add(other.items_[i]);
+    }
+}
+
+
+size_t RenderQueue::GetSize(void) const {
+
+    return items_.size();
+}
+
+
+size_t RenderQueue::GetNumBatches(void) const {
+
+    return num_batches_;
+}
+
+
+uint64_t RenderQueue::MakeKey(DrawPass pass, GLuint program, GLuint texture, GLuint mesh, float depth){
+
+    // Quantize depth so that closer items are drawn first within a batch
+    // of identical state, which helps early depth rejection
+    // Nodes with a broken transformation give no depth (NaN): keeping it
+    // out of the key keeps it from spilling into the other states
+    depth = (depth > 0.0f) ? std::min(depth, 1.0f) : 0.0f;
+    uint64_t depth_bits = (uint64_t) (depth * key_mask_g);
+
+    uint64_t key = ((program & program_mask_g) << (3*key_bits_g)) |
+                   ((texture & key_mask_g) << (2*key_bits_g)) |
+                   ((mesh & key_mask_g) << key_bits_g) |
+                   depth_bits;
+#ifdef GPU_PROFILER
+    key |= (uint64_t) pass << (4*key_bits_g - pass_bits_g);
+#else
+    // Items of all passes are sorted and batched together
+    (void) pass;
+#endif
+    return key;
+}
+
+
+DrawPass RenderQueue::GetPass(uint64_t key){
+
+    return (DrawPass) (key >> (4*key_bits_g - pass_bits_g));
+}
+
+
+const char *RenderQueue::GetPassName(DrawPass pass){
+
+    return pass_names_g[pass];
+}
+
+
+void RenderQueue::Sort(void){
+
+    std::sort(order_.begin(), order_.end());
+}
+
+
+bool RenderQueue::SameBatch(const DrawItem &a, const DrawItem &b){
+
+#ifdef GPU_PROFILER
+    // Each pass is measured on its own
+    if (GetPass(a.key) != GetPass(b.key)){
+        return false;
+    }
+#endif
+    return (a.program == b.program) &&
+           (a.vertex_array == b.vertex_array) &&
+           (a.texture == b.texture) &&
+           (a.sampler == b.sampler) &&
+           (a.mode == b.mode) &&
+           (a.size == b.size);
+}
+
+
+void RenderQueue::Submit(StreamBuffer *stream, GpuProfiler *profiler){
+
+    num_batches_ = 0;
+    if (order_.empty()){
+        return;
+    }
+
+    // Gather the instance data in sorted order, so that each batch reads a
+    // contiguous range of the instance buffer
+    instances_.resize(order_.size());
+    palettes_.clear();
+    for (size_t i = 0; i < order_.size(); i++){
+        const DrawItem &item = items_[order_[i].index];
+        instances_[i].world_matrix = item.world_matrix;
+        instances_[i].normal_matrix = item.normal_matrix;
+        instances_[i].layer = item.layer;
+        instances_[i].palette = (GLfloat) (4*palettes_.size());
+        palettes_.insert(palettes_.end(), item.palette, item.palette + item.palette_size);
+    }
+
+    // The map starts at the palettes of the frame
+    if (!palettes_.empty()){
+        if (!palette_map_){
+            InitPaletteMap();
+        }
+        size_t size = palettes_.size()*sizeof(glm::mat4);
+        if (size/sizeof(glm::vec4) > (size_t) max_palette_texels_){
+            throw(std::runtime_error(std::string("Too many moving parts for the palette map")));
+        }
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, palette_map_);
+        if (palette_range_){
+            // The palettes go first, so that the buffer they are in is the
+            // one the map reads even if the instances make it grow
+            GLintptr palette_base = stream->Upload(&palettes_[0], size, palette_alignment_);
+            glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, stream->GetBuffer(), palette_base, size);
+        } else {
+            // The map cannot cover the whole stream buffer, which may have
+            // more texels than allowed: respecify a buffer of their own
+            glBindBuffer(GL_TEXTURE_BUFFER, palette_buffer_);
+            glBufferData(GL_TEXTURE_BUFFER, size, &palettes_[0], GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_buffer_);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Copy them to the part of the stream buffer of the frame, which the
+    // GPU is not reading
+    GLintptr base = stream->Upload(&instances_[0], instances_.size()*sizeof(InstanceData));
+    glBindBuffer(GL_ARRAY_BUFFER, stream->GetBuffer());
+
+    // State currently bound in OpenGL
+    GLuint program = 0;
+    GLuint texture = 0;
+    GLuint sampler = 0;
+    GLuint mesh = 0;
+    bool first = true;
+#ifdef GPU_PROFILER
+    int pass = -1;
+#else
+    (void) profiler;
+#endif
+
+    size_t i = 0;
+    while (i < order_.size()){
+        const DrawItem &item = items_[order_[i].index];
+
+#ifdef GPU_PROFILER
+        // Items are sorted by pass first: measure each run of them
+        if (profiler && (GetPass(item.key) != pass)){
+            if (pass >= 0){
+                profiler->End();
+            }
+            pass = GetPass(item.key);
+            profiler->Begin(pass_names_g[pass]);
+        }
+#endif
+
+        // Find the end of the batch
+        size_t end = i + 1;
+        while ((end < order_.size()) && SameBatch(item, items_[order_[end].index])){
+            end++;
+        }
+        GLsizei count = (GLsizei) (end - i);
+
+        // Select proper material (shader program)
+        if (first || (item.program != program)){
+            glUseProgram(item.program);
+            program = item.program;
+        }
+
+        // Set geometry to draw
+        if (first || (item.vertex_array != mesh)){
+            glBindVertexArray(item.vertex_array);
+            mesh = item.vertex_array;
+        }
+
+        // Texture
+        if (item.texture && (first || (item.texture != texture))){
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, item.texture);
+            texture = item.texture;
+        }
+
+        // Texture interpolation, set up once when the sampler was created
+        if (item.texture && (item.sampler != sampler)){
+            glBindSampler(0, item.sampler);
+            sampler = item.sampler;
+        }
+
+        first = false;
+
+        // Point the per-instance data at the range of the batch
+        // Each matrix takes four locations, one per column
+        const GLsizei stride = sizeof(InstanceData);
+        size_t offset = base + i*sizeof(InstanceData);
+        for (int c = 0; c < 4; c++){
+            glVertexAttribPointer(WorldMatrixAttribute + c, 4, GL_FLOAT, GL_FALSE, stride, (void *) (offset + c*sizeof(glm::vec4)));
+            glVertexAttribPointer(NormalMatrixAttribute + c, 4, GL_FLOAT, GL_FALSE, stride, (void *) (offset + sizeof(glm::mat4) + c*sizeof(glm::vec4)));
+        }
+        glVertexAttribPointer(LayerAttribute, 1, GL_FLOAT, GL_FALSE, stride, (void *) (offset + offsetof(InstanceData, layer)));
+        glVertexAttribPointer(PaletteAttribute, 1, GL_FLOAT, GL_FALSE, stride, (void *) (offset + offsetof(InstanceData, palette)));
+
+        // Draw all instances of the geometry
+        if (item.mode == GL_POINTS){
+            glDrawArraysInstanced(item.mode, 0, item.size, count);
+        } else {
+            glDrawElementsInstanced(item.mode, item.size, item.index_type, 0, count);
+        }
+        num_batches_++;
+
+        i = end;
+    }
+
+#ifdef GPU_PROFILER
+    if (profiler && (pass >= 0)){
+        profiler->End();
+    }
+#endif
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindSampler(0, 0);
+}
+
+
+void RenderQueue::InitPaletteMap(void){
+
+    glGenTextures(1, &palette_map_);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_palette_texels_);
+
+    // Ranges must start at a multiple of the alignment of the driver
+    palette_range_ = GLEW_ARB_texture_buffer_range || GLEW_VERSION_4_3;
+    if (palette_range_){
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &palette_alignment_);
+        palette_alignment_ = std::max(palette_alignment_, (GLint) sizeof(glm::vec4));
+    } else {
+        glGenBuffers(1, &palette_buffer_);
+    }
+}
+
+} // namespace game
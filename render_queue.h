@@ -0,0 +1,125 @@
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include <vector>
+#include <stdint.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "resource.h"
+#include "gpu_profiler.h"
+#include "stream_buffer.h"
+
+namespace game {
+
+    // Groups of draw items, drawn one after the other in this order in
+    // GPU_PROFILER builds so that the time spent on each can be measured
+    typedef enum Pass { GroundPass = 0, BuildingPass = 1, EnemyPass = 2, ObjectPass = 3, NumDrawPasses = 4 } DrawPass;
+
+    // One draw request emitted while traversing the scene graph
+    struct DrawItem {
+        uint64_t key; // Sort key: (pass,) program, texture, mesh, depth
+        GLuint program; // Shader program
+        const MaterialLocations *locations; // Inputs of the shader program
+        GLuint texture; // Texture array (0 if none)
+        GLfloat layer; // Layer of the texture array
+        GLuint sampler; // Sampling state for the texture
+        GLuint vertex_array; // Geometry, with its vertex layout
+        GLenum mode; // Type of geometry
+        GLsizei size; // Number of primitives in geometry
+        GLenum index_type; // Type of the element array
+        glm::mat4 world_matrix; // World transformation, including scaling
+        glm::mat4 normal_matrix; // Transformation for normals
+        const glm::mat4 *palette; // Transformations of the moving parts of
+        GLsizei palette_size;     // a baked prefab (NULL and 0 if none);
+                                  // must stay valid until Submit
+    };
+
+    // Per-instance data read by the vertex shaders
+    struct InstanceData {
+        glm::mat4 world_matrix;
+        glm::mat4 normal_matrix;
+        GLfloat layer;
+        GLfloat palette; // First texel of the palette in the palette map
+    };
+
+    // Collects the draw items of a frame, sorts them by render state and
+    // submits them to OpenGL while skipping redundant state changes
+    // Consecutive items sharing program, geometry and texture array are
+    // drawn with a single instanced call, whatever layers they use; in
+    // GPU_PROFILER builds, the items are also sorted and batched by pass
+    // The palettes of the items go to a buffer texture bound to the second
+    // unit, four texels (the columns) per matrix; it only covers the
+    // palettes of the frame, within the texels drivers allow
+    class RenderQueue {
+
+        public:
+            RenderQueue(void);
+            ~RenderQueue();
+
+            // Remove all items from the queue
+            void Clear(void);
+            // Add one item to the queue
+            void Add(const DrawItem &item);
+            // Add all items of another queue, e.g. one filled by another
+            // thread; only Submit issues OpenGL calls, so queues can be
+            // filled in parallel
+            void Append(const RenderQueue &other);
+            // Sort the items by key
+            void Sort(void);
+            // Issue the OpenGL calls for all items, in sorted order
+            // The instance data goes to 'stream'; the per-frame uniform
+            // block must already be bound
+            // Each pass is measured as a scope of 'profiler', if given, in
+            // builds with GPU_PROFILER
+            void Submit(StreamBuffer *stream, GpuProfiler *profiler = NULL);
+
+            // Number of items currently in the queue
+            size_t GetSize(void) const;
+            // Number of draw calls issued by the last Submit
+            size_t GetNumBatches(void) const;
+
+            // Build a sort key from the render state of an item
+            // 'depth' is the normalized distance to the camera in [0, 1]
+            static uint64_t MakeKey(DrawPass pass, GLuint program, GLuint texture, GLuint mesh, float depth);
+            // Pass of the item with the given key; only kept in the key in
+            // GPU_PROFILER builds
+            static DrawPass GetPass(uint64_t key);
+            // Name of a pass, e.g. in profiler reports
+            static const char *GetPassName(DrawPass pass);
+
+        private:
+            // Sort entry pointing to an item, so that sorting does not
+            // move the matrices around
+            struct SortEntry {
+                uint64_t key;
+                GLuint index;
+                // Order by key, keeping submission order for equal keys
+                bool operator<(const SortEntry &other) const {
+                    return (key != other.key) ? (key < other.key) : (index < other.index);
+                }
+            };
+
+            // Check whether two items can be drawn in the same instanced call
+            static bool SameBatch(const DrawItem &a, const DrawItem &b);
+            // Create the palette map, and read the limits of the driver
+            void InitPaletteMap(void);
+
+            std::vector<DrawItem> items_;
+            std::vector<SortEntry> order_;
+            std::vector<InstanceData> instances_; // Matrices in sorted order
+            std::vector<glm::mat4> palettes_; // Palettes in sorted order
+            GLuint palette_map_; // Buffer texture reading the palettes
+            GLuint palette_buffer_; // Palettes, without texture buffer ranges
+            bool palette_range_; // Whether the map reads a range of the stream buffer
+            GLint palette_alignment_; // Alignment of the start of the range
+            GLint max_palette_texels_; // Size limit of the map
+            size_t num_batches_;
+
+    }; // class RenderQueue
+
+} // namespace game
+
+#endif // RENDER_QUEUE_H_
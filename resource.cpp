@@ -9,15 +9,30 @@ Resource::Resource(ResourceType type, std::string name, GLuint resource, GLsizei
     name_ = name;
     resource_ = resource;
     size_ = size;
+    index_type_ = GL_UNSIGNED_INT;
+    sampler_ = 0;
+    layer_ = 0;
+    bound_center_ = glm::vec3(0.0, 0.0, 0.0);
+    bound_radius_ = -1.0;
+    bound_min_ = glm::vec3(0.0, 0.0, 0.0);
+    bound_max_ = glm::vec3(0.0, 0.0, 0.0);
 }
 
 
-Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
+Resource::Resource(ResourceType type, std::string name, GLuint vertex_array, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
     type_ = type;
     name_ = name;
+    vertex_array_ = vertex_array;
     array_buffer_ = array_buffer;
     element_array_buffer_ = element_array_buffer;
     size_ = size;
+    index_type_ = GL_UNSIGNED_INT;
+    sampler_ = 0;
+    layer_ = 0;
+    bound_center_ = glm::vec3(0.0, 0.0, 0.0);
+    bound_radius_ = -1.0;
+    bound_min_ = glm::vec3(0.0, 0.0, 0.0);
+    bound_max_ = glm::vec3(0.0, 0.0, 0.0);
 }
 
 
@@ -56,9 +71,135 @@ GLuint Resource::GetElementArrayBuffer(void) const {
 }
 
 
+GLuint Resource::GetVertexArray(void) const {
+
+    return vertex_array_;
+}
+
+
 GLsizei Resource::GetSize(void) const {
 
     return size_;
 }
 
+
+GLenum Resource::GetIndexType(void) const {
+
+    return index_type_;
+}
+
+
+void Resource::SetIndexType(GLenum type){
+
+    index_type_ = type;
+}
+
+
+const MaterialLocations &Resource::GetLocations(void) const {
+
+    return locations_;
+}
+
+
+void Resource::SetLocations(const MaterialLocations &locations){
+
+    locations_ = locations;
+}
+
+
+GLuint Resource::GetSampler(void) const {
+
+    return sampler_;
+}
+
+
+void Resource::SetSampler(GLuint sampler){
+
+    sampler_ = sampler;
+}
+
+
+int Resource::GetLayer(void) const {
+
+    return layer_;
+}
+
+
+void Resource::SetLayer(int layer){
+
+    layer_ = layer;
+}
+
+
+glm::vec3 Resource::GetBoundCenter(void) const {
+
+    return bound_center_;
+}
+
+
+float Resource::GetBoundRadius(void) const {
+
+    return bound_radius_;
+}
+
+
+void Resource::SetBoundingSphere(glm::vec3 center, float radius){
+
+    bound_center_ = center;
+    bound_radius_ = radius;
+}
+
+
+glm::vec3 Resource::GetBoundMin(void) const {
+
+    return bound_min_;
+}
+
+
+glm::vec3 Resource::GetBoundMax(void) const {
+
+    return bound_max_;
+}
+
+
+void Resource::SetBoundingBox(glm::vec3 min, glm::vec3 max){
+
+    bound_min_ = min;
+    bound_max_ = max;
+}
+
+
+const std::vector<LevelOfDetail> &Resource::GetLevels(void) const {
+
+    return levels_;
+}
+
+
+const std::vector<GLfloat> &Resource::GetVertexData(void) const {
+
+    return vertex_data_;
+}
+
+
+const std::vector<GLuint> &Resource::GetFaceData(void) const {
+
+    return face_data_;
+}
+
+
+void Resource::SetGeometryData(const std::vector<GLfloat> &vertex, const std::vector<GLuint> &face){
+
+    vertex_data_ = vertex;
+    face_data_ = face;
+}
+
+
+void Resource::AddLevel(const Resource *geometry, float min_screen_size){
+
+    LevelOfDetail level;
+    level.geometry = geometry;
+    level.min_screen_size = min_screen_size;
+    levels_.push_back(level);
+}
+
 } // namespace game
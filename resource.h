@@ -2,14 +2,56 @@
 #define RESOURCE_H_
 
 #include <string>
+#include <vector>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 
 namespace game {
 
+    // Locations of the shader inputs used by the engine, resolved once
+    // when a material is loaded (-1 if the program does not use them)
+    struct MaterialLocations {
+        // Vertex attributes
+        GLint vertex;
+        GLint normal;
+        GLint color;
+        GLint uv;
+        GLint part;
+        // Instance attributes
+        GLint world_mat;
+        GLint normal_mat;
+        GLint layer;
+        GLint palette;
+        // Uniforms
+        GLint texture_map;
+        GLint palette_map;
+        // Uniform blocks
+        GLuint frame_block;
+    };
+
+    // Attribute locations shared by all materials, so that the vertex
+    // layout stored with a mesh works with any shader program
+    // The matrices are per-instance and take four locations each; the
+    // texture array layer and the start of the palette of a baked prefab
+    // are per-instance as well, and the part of the prefab is per-vertex
+    typedef enum Attribute { VertexAttribute = 0, NormalAttribute = 1, ColorAttribute = 2, UVAttribute = 3, WorldMatrixAttribute = 4, NormalMatrixAttribute = 8, LayerAttribute = 12, PaletteAttribute = 13, PartAttribute = 14 } AttributeLocation;
+
+    // Binding points of the uniform blocks shared by all materials
+    typedef enum BlockBinding { FrameBlockBinding = 0 } UniformBlockBinding;
+
     // Possible resource types
-    typedef enum Type { Material, PointSet, Mesh, Texture } ResourceType;
+    typedef enum Type { Material, PointSet, Mesh, Texture, Sampler } ResourceType;
+
+    class Resource;
+
+    // One level of a chain of geometries of decreasing detail
+    struct LevelOfDetail {
+        const Resource *geometry;
+        float min_screen_size; // Smallest projected diameter, in pixels,
+                               // at which the level is used
+    };
 
     // Class that holds one resource
     class Resource {
@@ -24,20 +66,59 @@ namespace game {
                 struct {
                     GLuint array_buffer_; // Buffers for geometry
                     GLuint element_array_buffer_;
+                    GLuint vertex_array_; // Vertex layout of the buffers
                 };
             };
             GLsizei size_; // Number of primitives in geometry
+            GLenum index_type_; // Type of the element array of a mesh
+            MaterialLocations locations_; // Shader inputs of a material
+            GLuint sampler_; // Sampling state used with a texture or material
+            int layer_; // Layer of a texture in its texture array
+            glm::vec3 bound_center_; // Bounding sphere of the geometry, in
+            float bound_radius_;     // object space (negative if unknown)
+            glm::vec3 bound_min_; // Bounding box of the geometry, in object
+            glm::vec3 bound_max_; // space
+            std::vector<LevelOfDetail> levels_; // Levels of detail, finest first
+            std::vector<GLfloat> vertex_data_; // Copy of the geometry kept in
+            std::vector<GLuint> face_data_;    // memory, for batching
 
         public:
             Resource(ResourceType type, std::string name, GLuint resource, GLsizei size);
-            Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
+            Resource(ResourceType type, std::string name, GLuint vertex_array, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
             ~Resource();
             ResourceType GetType(void) const;
             const std::string GetName(void) const;
             GLuint GetResource(void) const;
             GLuint GetArrayBuffer(void) const;
             GLuint GetElementArrayBuffer(void) const;
+            GLuint GetVertexArray(void) const;
             GLsizei GetSize(void) const;
+            // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT (the default)
+            GLenum GetIndexType(void) const;
+            void SetIndexType(GLenum type);
+            const MaterialLocations &GetLocations(void) const;
+            void SetLocations(const MaterialLocations &locations);
+            GLuint GetSampler(void) const;
+            void SetSampler(GLuint sampler);
+            // Textures are layers of texture arrays: the resource handle
+            // is the array, shared by all of its layers
+            int GetLayer(void) const;
+            void SetLayer(int layer);
+            glm::vec3 GetBoundCenter(void) const;
+            float GetBoundRadius(void) const;
+            void SetBoundingSphere(glm::vec3 center, float radius);
+            glm::vec3 GetBoundMin(void) const;
+            glm::vec3 GetBoundMax(void) const;
+            void SetBoundingBox(glm::vec3 min, glm::vec3 max);
+            // Levels of detail of a geometry, ordered from the finest to
+            // the coarsest; empty when the geometry has a single level
+            const std::vector<LevelOfDetail> &GetLevels(void) const;
+            void AddLevel(const Resource *geometry, float min_screen_size);
+            // Copy of the vertices (11 floats each) and face indices of a
+            // geometry, in object space
+            const std::vector<GLfloat> &GetVertexData(void) const;
+            const std::vector<GLuint> &GetFaceData(void) const;
+            void SetGeometryData(const std::vector<GLfloat> &vertex, const std::vector<GLuint> &face);
 
     }; // class Resource
 
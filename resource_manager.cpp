@@ -4,13 +4,17 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <SOIL/SOIL.h>
 
 #include "resource_manager.h"
+#include "mesh_optimizer.h"
 
 namespace game {
 
 ResourceManager::ResourceManager(void){
+
+    vertex_layout_ = GetVertexLayout<FloatVertexFormat>();
 }
 
 
@@ -18,23 +22,30 @@ ResourceManager::~ResourceManager(){
 }
 
 
-void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size){
+Resource *ResourceManager::AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size){
 
     Resource *res;
 
     res = new Resource(type, name, resource, size);
 
     resource_.push_back(res);
+
+    return res;
 }
 
 
-void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
+Resource *ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
 
     Resource *res;
 
-    res = new Resource(type, name, array_buffer, element_array_buffer, size);
+    // Record the vertex layout once, so that drawing only binds it
+    GLuint vertex_array = CreateVertexArray(array_buffer, element_array_buffer);
+
+    res = new Resource(type, name, vertex_array, array_buffer, element_array_buffer, size);
 
     resource_.push_back(res);
+
+    return res;
 }
 
 
@@ -69,73 +80,308 @@ void ResourceManager::RemoveResource(std::string name){
 	for (int i = 0; i < resource_.size(); i++) {
 		if (resource_[i]->GetName() == name) {
 			 resource_.erase(resource_.begin() + i);
+			 i--;
 		}
 	}
 
 }
 
 
-void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
+void ResourceManager::LoadFeedbackMaterial(const std::string name, const char *prefix, const std::vector<std::string> &varyings){
+
+    if (varyings.empty()){
+        throw(std::invalid_argument(std::string("No outputs to capture for material ")+name));
+    }
+    LoadMaterial(name, prefix, varyings);
+}
+
+
+// Attribute locations shared by all programs, so that they match the
+// layout stored with the meshes
+const struct { GLuint location; const char *name; } attribute_bindings_g[] = {
+    {VertexAttribute, "vertex"},
+    {NormalAttribute, "normal"},
+    {ColorAttribute, "color"},
+    {UVAttribute, "uv"},
+    {WorldMatrixAttribute, "world_mat"},
+    {NormalMatrixAttribute, "normal_mat"},
+    {LayerAttribute, "layer"},
+    {PaletteAttribute, "palette"},
+    {PartAttribute, "part"}
+};
+const int num_attribute_bindings_g = sizeof(attribute_bindings_g) / sizeof(attribute_bindings_g[0]);
+
+
+void ResourceManager::LoadMaterial(const std::string name, const char *prefix, const std::vector<std::string> &varyings){
+
+    // Programs capturing their outputs run no fragment program
+    bool feedback = !varyings.empty();
 
     // Load vertex program source code
     std::string filename = std::string(prefix) + std::string(VERTEX_PROGRAM_EXTENSION);
     std::string vp = LoadTextFile(filename.c_str());
 
     // Load fragment program source code
-    filename = std::string(prefix) + std::string(FRAGMENT_PROGRAM_EXTENSION);
-    std::string fp = LoadTextFile(filename.c_str());
+    std::string fp;
+    if (!feedback){
+        filename = std::string(prefix) + std::string(FRAGMENT_PROGRAM_EXTENSION);
+        fp = LoadTextFile(filename.c_str());
+    }
 
-    // Create a shader from the vertex program source code
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    const char *source_vp = vp.c_str();
-    glShaderSource(vs, 1, &source_vp, NULL);
-    glCompileShader(vs);
+    // Everything the linked program depends on: sources, captured outputs
+    // and attribute locations
+    std::vector<std::string> key_sources;
+    key_sources.push_back(vp);
+    key_sources.push_back(fp);
+    key_sources.insert(key_sources.end(), varyings.begin(), varyings.end());
+    for (int i = 0; i < num_attribute_bindings_g; i++){
+        std::stringstream ss;
+        ss << attribute_bindings_g[i].name << "=" << attribute_bindings_g[i].location;
+        key_sources.push_back(ss.str());
+    }
+
+    PendingMaterial pending;
+    pending.program = glCreateProgram();
+    pending.vertex_shader = 0;
+    pending.fragment_shader = 0;
+    pending.key = ProgramCache::MakeKey(key_sources);
+
+    // Reuse the program linked by an earlier run when possible
+    if (!program_cache_.Load(pending.key, pending.program)){
+
+        // Let the driver compile on its own threads, so that the programs
+        // loaded one after the other build in parallel
+        if (GLEW_KHR_parallel_shader_compile){
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+
+        // Start compiling the shaders; their status is only checked in
+        // FinishMaterials, so that this call does not wait for the driver
+        pending.vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        const char *source_vp = vp.c_str();
+        glShaderSource(pending.vertex_shader, 1, &source_vp, NULL);
+        glCompileShader(pending.vertex_shader);
+        glAttachShader(pending.program, pending.vertex_shader);
+
+        if (!feedback){
+            pending.fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+            const char *source_fp = fp.c_str();
+            glShaderSource(pending.fragment_shader, 1, &source_fp, NULL);
+            glCompileShader(pending.fragment_shader);
+            glAttachShader(pending.program, pending.fragment_shader);
+        }
 
-    // Check if shader compiled successfully
-    GLint status;
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE){
-        char buffer[512];
-        glGetShaderInfoLog(vs, 512, NULL, buffer);
-        throw(std::ios_base::failure(std::string("Error compiling vertex shader: ")+std::string(buffer)));
+        // Write the captured outputs one after the other in a single buffer
+        if (feedback){
+            std::vector<const char *> names;
+            for (size_t i = 0; i < varyings.size(); i++){
+                names.push_back(varyings[i].c_str());
+            }
+            glTransformFeedbackVaryings(pending.program, (GLsizei) names.size(), &names[0], GL_INTERLEAVED_ATTRIBS);
+        }
+
+        for (int i = 0; i < num_attribute_bindings_g; i++){
+            glBindAttribLocation(pending.program, attribute_bindings_g[i].location, attribute_bindings_g[i].name);
+        }
+
+        if (program_cache_.IsEnabled()){
+            glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(pending.program);
     }
 
-    // Create a shader from the fragment program source code
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    const char *source_fp = fp.c_str();
-    glShaderSource(fs, 1, &source_fp, NULL);
-    glCompileShader(fs);
+    // The resource exists right away; its shader inputs are filled in once
+    // the program is linked
+    pending.resource = AddResource(Material, name, pending.program, 0);
+    pending_materials_.push_back(pending);
+}
+
 
-    // Check if shader compiled successfully
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE){
-        char buffer[512];
-        glGetShaderInfoLog(fs, 512, NULL, buffer);
-        throw(std::ios_base::failure(std::string("Error compiling fragment shader: ")+std::string(buffer)));
+void ResourceManager::FinishMaterials(void){
+
+    for (size_t i = 0; i < pending_materials_.size(); i++){
+        PendingMaterial &pending = pending_materials_[i];
+        GLuint sp = pending.program;
+
+        // Check if shaders were compiled and linked successfully; this
+        // waits for the driver if it is still busy
+        GLint status;
+        glGetProgramiv(sp, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE){
+            char buffer[512];
+            GLuint shaders[2] = {pending.vertex_shader, pending.fragment_shader};
+            const char *kinds[2] = {"vertex", "fragment"};
+            for (int j = 0; j < 2; j++){
+                if (shaders[j]){
+                    glGetShaderiv(shaders[j], GL_COMPILE_STATUS, &status);
+                    if (status != GL_TRUE){
+                        glGetShaderInfoLog(shaders[j], 512, NULL, buffer);
+                        throw(std::ios_base::failure(std::string("Error compiling ")+std::string(kinds[j])+std::string(" shader of ")+pending.resource->GetName()+std::string(": ")+std::string(buffer)));
+                    }
+                }
+            }
+            glGetProgramInfoLog(sp, 512, NULL, buffer);
+            throw(std::ios_base::failure(std::string("Error linking shaders of ")+pending.resource->GetName()+std::string(": ")+std::string(buffer)));
+        }
+
+        // Save programs built from source for the next run, and delete
+        // memory used by shaders, since they were already compiled and
+        // linked
+        if (pending.vertex_shader){
+            program_cache_.Save(pending.key, sp);
+            glDeleteShader(pending.vertex_shader);
+            if (pending.fragment_shader){
+                glDeleteShader(pending.fragment_shader);
+            }
+        }
+
+        // Keep the locations of the shader inputs with the material, so
+        // that they are not queried when drawing
+        MaterialLocations loc = GetMaterialLocations(sp);
+        pending.resource->SetLocations(loc);
+
+        // Connect the per-frame uniform block, assign the first texture
+        // unit to the map and the second one to the palette of the baked
+        // prefabs; these never change afterwards
+        if (loc.frame_block != GL_INVALID_INDEX){
+            glUniformBlockBinding(sp, loc.frame_block, FrameBlockBinding);
+        }
+        glUseProgram(sp);
+        if (loc.texture_map >= 0){
+            glUniform1i(loc.texture_map, 0);
+        }
+        if (loc.palette_map >= 0){
+            glUniform1i(loc.palette_map, 1);
+        }
+        glUseProgram(0);
     }
 
-    // Create a shader program linking both vertex and fragment shaders
-    // together
-    GLuint sp = glCreateProgram();
-    glAttachShader(sp, vs);
-    glAttachShader(sp, fs);
-    glLinkProgram(sp);
+    pending_materials_.clear();
+}
 
-    // Check if shaders were linked successfully
-    glGetProgramiv(sp, GL_LINK_STATUS, &status);
-    if (status != GL_TRUE){
-        char buffer[512];
-        glGetShaderInfoLog(sp, 512, NULL, buffer);
-        throw(std::ios_base::failure(std::string("Error linking shaders: ")+std::string(buffer)));
+
+void ResourceManager::SetProgramCacheDirectory(const std::string &directory){
+
+    program_cache_.SetDirectory(directory);
+}
+
+
+GLuint ResourceManager::CreateVertexArray(GLuint array_buffer, GLuint element_array_buffer){
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    // The element array buffer binding is part of the vertex array state
+    glBindBuffer(GL_ARRAY_BUFFER, array_buffer);
+    if (element_array_buffer){
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer);
+    }
+
+    // Per-vertex attributes, as laid out by the vertex format
+    vertex_layout_->setup();
+
+    // Per-instance matrices, one column per location, texture layer and
+    // start of the palette; the render queue points them at its instance
+    // buffer before each draw
+    for (int i = 0; i < 4; i++){
+        glEnableVertexAttribArray(WorldMatrixAttribute + i);
+        glVertexAttribDivisor(WorldMatrixAttribute + i, 1);
+        glEnableVertexAttribArray(NormalMatrixAttribute + i);
+        glVertexAttribDivisor(NormalMatrixAttribute + i, 1);
     }
+    glEnableVertexAttribArray(LayerAttribute);
+    glVertexAttribDivisor(LayerAttribute, 1);
+    glEnableVertexAttribArray(PaletteAttribute);
+    glVertexAttribDivisor(PaletteAttribute, 1);
 
-    // Delete memory used by shaders, since they were already compiled
-    // and linked
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    glBindVertexArray(0);
 
-    // Add a resource for the shader program
-    AddResource(Material, name, sp, 0);
+    return vao;
+}
+
+
+void ResourceManager::SetVertexFormat(const VertexLayout *layout){
+
+    vertex_layout_ = layout;
+}
+
+
+const VertexLayout *ResourceManager::GetVertexFormat(void) const {
+
+    return vertex_layout_;
+}
+
+
+GLuint ResourceManager::CreateVertexBuffer(const GLfloat *vertex, int num_vertices){
+
+    // Pack the vertices into the format of the buffer
+    GLsizei stride = vertex_layout_->stride;
+    std::vector<unsigned char> packed(num_vertices*stride);
+    for (int i = 0; i < num_vertices; i++){
+        vertex_layout_->pack(vertex + i*UnpackedVertexSize, &packed[i*stride]);
+    }
+
+    GLuint vbo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.empty() ? NULL : &packed[0], GL_STATIC_DRAW);
+    return vbo;
+}
+
+
+void ResourceManager::KeepGeometry(Resource *res, const GLfloat *vertex, int num_vertices, const GLuint *face, int num_indices){
+
+    if (num_vertices <= 0){
+        return;
+    }
+
+    res->SetGeometryData(std::vector<GLfloat>(vertex, vertex + num_vertices*UnpackedVertexSize),
+                         std::vector<GLuint>(face, face + num_indices));
+
+    // Center the sphere on the bounding box of the positions, then grow it
+    // to reach the farthest vertex
+    glm::vec3 box_min(vertex[0], vertex[1], vertex[2]);
+    glm::vec3 box_max = box_min;
+    for (int i = 1; i < num_vertices; i++){
+        glm::vec3 position(vertex[i*UnpackedVertexSize], vertex[i*UnpackedVertexSize + 1], vertex[i*UnpackedVertexSize + 2]);
+        box_min = glm::min(box_min, position);
+        box_max = glm::max(box_max, position);
+    }
+    glm::vec3 center = (box_min + box_max) * 0.5f;
+
+    float radius = 0.0;
+    for (int i = 0; i < num_vertices; i++){
+        glm::vec3 position(vertex[i*UnpackedVertexSize], vertex[i*UnpackedVertexSize + 1], vertex[i*UnpackedVertexSize + 2]);
+        radius = std::max(radius, glm::length(position - center));
+    }
+
+    res->SetBoundingBox(box_min, box_max);
+    res->SetBoundingSphere(center, radius);
+}
+
+
+MaterialLocations ResourceManager::GetMaterialLocations(GLuint program){
+
+    MaterialLocations loc;
+
+    loc.vertex = glGetAttribLocation(program, "vertex");
+    loc.normal = glGetAttribLocation(program, "normal");
+    loc.color = glGetAttribLocation(program, "color");
+    loc.uv = glGetAttribLocation(program, "uv");
+    loc.part = glGetAttribLocation(program, "part");
+
+    loc.world_mat = glGetAttribLocation(program, "world_mat");
+    loc.normal_mat = glGetAttribLocation(program, "normal_mat");
+    loc.layer = glGetAttribLocation(program, "layer");
+    loc.palette = glGetAttribLocation(program, "palette");
+
+    loc.texture_map = glGetUniformLocation(program, "texture_map");
+    loc.palette_map = glGetUniformLocation(program, "palette_map");
+
+    loc.frame_block = glGetUniformBlockIndex(program, "FrameBlock");
+
+    return loc;
 }
 
 
@@ -162,7 +408,93 @@ std::string ResourceManager::LoadTextFile(const char *filename){
 }
 
 
-void ResourceManager::CreateTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples){
+// Largest error allowed for a level of detail, in pixels
+const float lod_pixel_error_g = 1.0;
+
+
+// Largest projected diameter, in pixels, at which a geometry of the given
+// diameter can be drawn with a level of detail off by 'error' in world
+// units
+static float MaxScreenSize(float diameter, float error){
+
+    return lod_pixel_error_g * diameter / error;
+}
+
+
+void ResourceManager::CreateTorus(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples, int num_levels){
+
+    // Create the levels from the finest to the coarsest
+    std::vector<Resource *> level;
+    std::vector<float> error;
+    for (int i = 0; i < num_levels; i++){
+        if (i > 0){
+            // Halve the number of samples, keeping enough for a closed shape
+            num_loop_samples = (num_loop_samples + 1) / 2;
+            num_circle_samples = (num_circle_samples + 1) / 2;
+            if ((num_loop_samples < 8) || (num_circle_samples < 6)){
+                break;
+            }
+        }
+        std::stringstream name;
+        name << object_name;
+        if (i > 0){
+            name << "Level" << i;
+        }
+        level.push_back(CreateTorusLevel(name.str(), loop_radius, circle_radius, num_loop_samples, num_circle_samples));
+
+        // Distance between the polygons and the true surface
+        float loop_step = 2.0*glm::pi<GLfloat>()/num_loop_samples;
+        float circle_step = 2.0*glm::pi<GLfloat>()/num_circle_samples;
+        error.push_back(std::max((loop_radius + circle_radius)*(1.0f - cos(loop_step/2.0f)),
+                                 circle_radius*(1.0f - cos(circle_step/2.0f))));
+    }
+
+    // Each level is used until the next one would show a visible error
+    float diameter = 2.0*(loop_radius + circle_radius);
+    for (size_t i = 0; (level.size() > 1) && (i < level.size()); i++){
+        float min_size = (i + 1 < level.size()) ? MaxScreenSize(diameter, error[i + 1]) : 0.0;
+        level[0]->AddLevel(level[i], min_size);
+    }
+}
+
+
+void ResourceManager::CreateSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi, int num_levels){
+
+    // Create the levels from the finest to the coarsest
+    std::vector<Resource *> level;
+    std::vector<float> error;
+    for (int i = 0; i < num_levels; i++){
+        if (i > 0){
+            // Halve the number of samples, keeping enough for a closed shape
+            num_samples_theta = (num_samples_theta + 1) / 2;
+            num_samples_phi = (num_samples_phi + 1) / 2;
+            if ((num_samples_theta < 8) || (num_samples_phi < 5)){
+                break;
+            }
+        }
+        std::stringstream name;
+        name << object_name;
+        if (i > 0){
+            name << "Level" << i;
+        }
+        level.push_back(CreateSphereLevel(name.str(), radius, num_samples_theta, num_samples_phi));
+
+        // Distance between the polygons and the true surface, given by the
+        // largest angle between samples
+        float step = std::max(2.0f*glm::pi<GLfloat>()/(num_samples_theta-1),
+                              glm::pi<GLfloat>()/(num_samples_phi-1));
+        error.push_back(radius*(1.0f - cos(step/2.0f)));
+    }
+
+    // Each level is used until the next one would show a visible error
+    for (size_t i = 0; (level.size() > 1) && (i < level.size()); i++){
+        float min_size = (i + 1 < level.size()) ? MaxScreenSize(2.0f*radius, error[i + 1]) : 0.0;
+        level[0]->AddLevel(level[i], min_size);
+    }
+}
+
+
+Resource *ResourceManager::CreateTorusLevel(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples){
 
     // Create a torus
     // The torus is built from a large loop with small circles around the loop
@@ -174,7 +506,7 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
     const GLuint face_num = num_loop_samples*num_circle_samples*2;
 
     // Number of attributes for vertices and faces
-    const int vertex_att = 11;
+    const int vertex_att = UnpackedVertexSize;
     const int face_att = 3;
 
     // Data buffers for the torus
@@ -245,30 +577,18 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
         }
     }
 
-    // Create OpenGL buffers and copy data
-    //GLuint vao;
-    //glGenVertexArrays(1, &vao);
-    //glBindVertexArray(vao);
-
-    GLuint vbo, ebo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+    // Create resource, with OpenGL buffers holding the optimized mesh
+    Resource *res = CreateMesh(object_name, std::vector<GLfloat>(vertex, vertex + vertex_num * vertex_att), std::vector<GLuint>(face, face + face_num * face_att));
 
     // Free data buffers
     delete [] vertex;
     delete [] face;
 
-    // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    return res;
 }
 
 
-void ResourceManager::CreateSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi){
+Resource *ResourceManager::CreateSphereLevel(std::string object_name, float radius, int num_samples_theta, int num_samples_phi){
 
     // Create a sphere using a well-known parameterization
 
@@ -277,7 +597,7 @@ void ResourceManager::CreateSphere(std::string object_name, float radius, int nu
     const GLuint face_num = num_samples_theta*(num_samples_phi-1)*2;
 
     // Number of attributes for vertices and faces
-    const int vertex_att = 11;
+    const int vertex_att = UnpackedVertexSize;
     const int face_att = 3;
 
     // Data buffers 
@@ -347,26 +667,14 @@ void ResourceManager::CreateSphere(std::string object_name, float radius, int nu
         }
     }
 
-    // Create OpenGL buffers and copy data
-    //GLuint vao;
-    //glGenVertexArrays(1, &vao);
-    //glBindVertexArray(vao);
-
-    GLuint vbo, ebo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+    // Create resource, with OpenGL buffers holding the optimized mesh
+    Resource *res = CreateMesh(object_name, std::vector<GLfloat>(vertex, vertex + vertex_num * vertex_att), std::vector<GLuint>(face, face + face_num * face_att));
 
     // Free data buffers
     delete [] vertex;
     delete [] face;
 
-    // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    return res;
 }
 
 
@@ -418,22 +726,13 @@ void ResourceManager::CreateCube(std::string object_name) {
 	};
 
 
-	GLuint vbo, ebo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
 	std::vector<GLuint> indices;
 
 	for (int i = 0; i < 36; i++)
 		indices.push_back(i);
 
-
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 36, &indices[0], GL_STATIC_DRAW);
-
-	AddResource(Mesh, object_name, vbo, ebo, indices.size());
+	// The faces share vertices once welded
+	CreateMesh(object_name, std::vector<GLfloat>(cubeVertices, cubeVertices + 36 * UnpackedVertexSize), indices);
 }
 
 void ResourceManager::CreateGround(std::string name) {
@@ -482,22 +781,13 @@ void ResourceManager::CreateGround(std::string name) {
 	};
 
 
-	GLuint vbo, ebo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
 	std::vector<GLuint> indices;
 
 	for (int i = 0; i < 36; i++)
 		indices.push_back(i);
 
-
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 36, &indices[0], GL_STATIC_DRAW);
-
-	AddResource(Mesh, name, vbo, ebo, indices.size());
+	// The faces share vertices once welded
+	CreateMesh(name, std::vector<GLfloat>(cubeVertices, cubeVertices + 36 * UnpackedVertexSize), indices);
 
 }
 
@@ -547,22 +837,13 @@ void ResourceManager::CreateParts(std::string name) {
 	};
 
 
-	GLuint vbo, ebo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
 	std::vector<GLuint> indices;
 
 	for (int i = 0; i < 36; i++)
 		indices.push_back(i);
 
-
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 36, &indices[0], GL_STATIC_DRAW);
-
-	AddResource(Mesh, name, vbo, ebo, indices.size());
+	// The faces share vertices once welded
+	CreateMesh(name, std::vector<GLfloat>(cubeVertices, cubeVertices + 36 * UnpackedVertexSize), indices);
 
 }
 
@@ -579,7 +860,7 @@ void ResourceManager::CreateSphereParticles(std::string object_name, int num_par
 	GLfloat *particle = NULL;
 
 	// Number of attributes per particle: position (3), normal (3), and color (3), texture coordinates (2)
-	const int particle_att = 11;
+	const int particle_att = UnpackedVertexSize;
 
 	// Allocate memory for buffer
 	try {
@@ -621,29 +902,193 @@ void ResourceManager::CreateSphereParticles(std::string object_name, int num_par
 	}
 
 	// Create OpenGL buffers and copy data
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, num_particles * particle_att * sizeof(GLfloat), particle, GL_STATIC_DRAW);
+	GLuint vbo = CreateVertexBuffer(particle, num_particles);
+
+	// Create resource
+	Resource *res = AddResource(PointSet, object_name, vbo, 0, num_particles);
+	KeepGeometry(res, particle, num_particles, NULL, 0);
 
 	// Free data buffers
 	delete[] particle;
+}
 
-	// Create resource
-	AddResource(PointSet, object_name, vbo, 0, num_particles);
+
+Resource *ResourceManager::CreateMesh(std::string object_name, const std::vector<GLfloat> &vertex, const std::vector<GLuint> &face){
+
+    // Weld and reorder the geometry for the vertex caches of the GPU
+    std::vector<GLfloat> optimized_vertex(vertex);
+    std::vector<GLuint> optimized_face(face);
+    MeshOptimizer::Optimize(optimized_vertex, optimized_face);
+    if (optimized_vertex.empty() || optimized_face.empty()){
+        throw(std::invalid_argument(std::string("Empty mesh: ")+object_name));
+    }
+    int num_vertices = (int) (optimized_vertex.size() / UnpackedVertexSize);
+
+    // Create OpenGL buffers and copy data
+    GLuint vbo = CreateVertexBuffer(&optimized_vertex[0], num_vertices);
+
+    // Indices take half the memory when 16 bits address all vertices
+    GLenum index_type = MeshOptimizer::GetIndexType(num_vertices);
+    GLuint ebo;
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    if (index_type == GL_UNSIGNED_SHORT){
+        std::vector<GLushort> short_face(optimized_face.begin(), optimized_face.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_face.size() * sizeof(GLushort), &short_face[0], GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, optimized_face.size() * sizeof(GLuint), &optimized_face[0], GL_STATIC_DRAW);
+    }
+
+    // Create resource
+    Resource *res = AddResource(Mesh, object_name, vbo, ebo, optimized_face.size());
+    res->SetIndexType(index_type);
+    KeepGeometry(res, &optimized_vertex[0], num_vertices, &optimized_face[0], optimized_face.size());
+
+    return res;
 }
 
 
 void ResourceManager::LoadTexture(const std::string name, const char *filename){
 
-    // Load texture from file
-    GLuint texture = SOIL_load_OGL_texture(filename, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, 0);
-    if (!texture){
-        throw(std::ios_base::failure(std::string("Error loading texture ")+std::string(filename)+std::string(": ")+std::string(SOIL_last_result())));
+    // A single texture is an array with one layer, of the size of the image
+    LoadTextureArray(std::vector<std::string>(1, name), std::vector<std::string>(1, filename));
+}
+
+
+void ResourceManager::LoadTextureArray(const std::vector<std::string> &names, const std::vector<std::string> &filenames, int width, int height){
+
+    if (names.empty() || (names.size() != filenames.size())){
+        throw(std::invalid_argument(std::string("Invalid texture array")));
     }
 
-    // Create resource
-    AddResource(Texture, name, texture, 0);
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    try {
+        // Upload block-compressed layers when the hardware reads them
+        if (GLEW_EXT_texture_compression_s3tc){
+            LoadCompressedLayers(filenames, width, height);
+        } else {
+            LoadLayers(filenames, width, height);
+        }
+    }
+    catch (...){
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glDeleteTextures(1, &texture);
+        throw;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Create one resource per layer, all referring to the array
+    GLuint sampler = GetDefaultSampler();
+    for (size_t i = 0; i < names.size(); i++){
+        Resource *res = AddResource(Texture, names[i], texture, 0);
+        res->SetSampler(sampler);
+        res->SetLayer((int) i);
+    }
+}
+
+
+void ResourceManager::LoadLayers(const std::vector<std::string> &filenames, int width, int height){
+
+    std::vector<unsigned char> resampled;
+    for (size_t i = 0; i < filenames.size(); i++){
+        // Load the image as RGBA, rows in file order as with single textures
+        int image_width, image_height, channels;
+        unsigned char *image = SOIL_load_image(filenames[i].c_str(), &image_width, &image_height, &channels, SOIL_LOAD_RGBA);
+        if (!image){
+            throw(std::ios_base::failure(std::string("Error loading texture ")+filenames[i]+std::string(": ")+std::string(SOIL_last_result())));
+        }
+
+        // The layers take the requested size, or the size of the first image
+        if (i == 0){
+            if ((width <= 0) || (height <= 0)){
+                width = image_width;
+                height = image_height;
+            }
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (GLsizei) filenames.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+
+        const unsigned char *pixels = image;
+        if ((image_width != width) || (image_height != height)){
+            resampled.resize(4*width*height);
+            TextureCache::Resample(image, image_width, image_height, &resampled[0], width, height);
+            pixels = &resampled[0];
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint) i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        SOIL_free_image_data(image);
+    }
+
+    // Build the mipmap chain once, since the sampler filters with mipmaps
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+
+void ResourceManager::LoadCompressedLayers(const std::vector<std::string> &filenames, int width, int height){
+
+    // Cooked images, with their mipmaps; the first one sets the size of
+    // the layers when none is given
+    std::vector<CompressedImage> images(filenames.size());
+    bool alpha = false;
+    for (size_t i = 0; i < filenames.size(); i++){
+        texture_cache_.Get(filenames[i], width, height, false, images[i]);
+        width = images[i].width;
+        height = images[i].height;
+        alpha = alpha || (images[i].format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+    }
+
+    // All layers share one format: keep the alpha channel if any needs it
+    GLenum format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    for (size_t i = 0; i < filenames.size(); i++){
+        if (images[i].format != format){
+            texture_cache_.Get(filenames[i], width, height, true, images[i]);
+        }
+    }
+
+    GLsizei num_layers = (GLsizei) filenames.size();
+    for (size_t level = 0; level < images[0].levels.size(); level++){
+        int level_width = std::max(width >> level, 1);
+        int level_height = std::max(height >> level, 1);
+        GLsizei size = (GLsizei) TextureCache::GetLevelSize(format, level_width, level_height);
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint) level, format, level_width, level_height, num_layers, 0, size*num_layers, NULL);
+        for (GLsizei i = 0; i < num_layers; i++){
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint) level, 0, 0, i, level_width, level_height, 1, format, size, &images[i].levels[level][0]);
+        }
+    }
+}
+
+
+void ResourceManager::CreateSampler(std::string sampler_name, GLint min_filter, GLint mag_filter, GLint wrap){
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+
+    // Define texture interpolation
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, min_filter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, mag_filter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrap);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrap);
+
+    AddResource(Sampler, sampler_name, sampler, 0);
+}
+
+
+GLuint ResourceManager::GetDefaultSampler(void){
+
+    // Create the default sampler with the first texture, once an OpenGL
+    // context is available
+    Resource *res = GetResource("DefaultSampler");
+    if (!res){
+        CreateSampler("DefaultSampler", GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT);
+        res = GetResource("DefaultSampler");
+    }
+
+    return res->GetResource();
+}
+
+void ResourceManager::SetTextureCacheDirectory(const std::string &directory){
+
+    texture_cache_.SetDirectory(directory);
 }
 
 } // namespace game;
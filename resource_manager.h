@@ -8,6 +8,9 @@
 #include <GLFW/glfw3.h>
 
 #include "resource.h"
+#include "texture_cache.h"
+#include "program_cache.h"
+#include "vertex_format.h"
 
 // Default extensions for different shader source files
 #define VERTEX_PROGRAM_EXTENSION "_vp.glsl"
@@ -23,35 +26,108 @@ namespace game {
             ResourceManager(void);
             ~ResourceManager();
             // Add a resource that was already loaded and allocated to memory
-            void AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size);
-            void AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
+            Resource *AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size);
+            Resource *AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
             // Load a resource from a file, according to the specified type
+            // Materials are compiled in the background: call
+            // FinishMaterials before drawing with them
             void LoadResource(ResourceType type, const std::string name, const char *filename);
+            // Load a vertex program whose outputs named in 'varyings' are
+            // captured with transform feedback, interleaved in one buffer
+            void LoadFeedbackMaterial(const std::string name, const char *prefix, const std::vector<std::string> &varyings);
+            // Wait for the materials loaded so far to be linked, report
+            // errors, and resolve their shader inputs
+            void FinishMaterials(void);
+            // Load images into the layers of a single texture array, adding
+            // one texture resource per layer, so that nodes using any of
+            // them can be drawn together
+            // Images are resampled to 'width' x 'height', or to the size of
+            // the first image when no size is given
+            void LoadTextureArray(const std::vector<std::string> &names, const std::vector<std::string> &filenames, int width = 0, int height = 0);
             // Get the resource with the specified name
             Resource *GetResource(const std::string name) const;
 
+			// Forget the resources with the given name; whoever created
+			// them deletes them
 			void RemoveResource(std::string name);
 
             // Methods to create specific resources
             // Create the geometry for a torus and add it to the list of resources
-            void CreateTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30);
-            void CreateSphere(std::string object_name, float radius = 0.6, int num_samples_theta = 90, int num_samples_phi = 45);
+            // Up to 'num_levels' levels of detail are created, halving the
+            // number of samples each time
+            void CreateTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30, int num_levels = 4);
+            void CreateSphere(std::string object_name, float radius = 0.6, int num_samples_theta = 90, int num_samples_phi = 45, int num_levels = 4);
 			void CreateCube(std::string object_name);
 			void CreateGround(std::string object_name);
 			void CreateParts(std::string object_name);
 			void CreateSphereParticles(std::string object_name, int num_particles = 20000);
+            // Create a triangle mesh from unpacked vertices (11 floats each)
+            // and faces already in memory
+            // All meshes go through the mesh optimizer, and use 16-bit
+            // indices when they have few enough vertices
+            Resource *CreateMesh(std::string object_name, const std::vector<GLfloat> &vertex, const std::vector<GLuint> &face);
+            // Create a sampler object describing how textures are filtered
+            // and wrapped
+            void CreateSampler(std::string sampler_name, GLint min_filter, GLint mag_filter, GLint wrap);
+            // Format of the vertex buffers of the geometry created from now
+            // on, e.g. GetVertexLayout<PackedVertexFormat>(); geometry is
+            // still kept on the CPU unpacked
+            // The default format stores floats only, as built
+            void SetVertexFormat(const VertexLayout *layout);
+            const VertexLayout *GetVertexFormat(void) const;
+            // Directory where compressed textures are kept between runs
+            void SetTextureCacheDirectory(const std::string &directory);
+            // Directory where linked programs are kept between runs
+            void SetProgramCacheDirectory(const std::string &directory);
 
         private:
             // List storing all resources
             std::vector<Resource*> resource_; 
+            // Compressed versions of the texture files
+            TextureCache texture_cache_;
+            // Binaries of the linked programs
+            ProgramCache program_cache_;
+            // Format of new vertex buffers
+            const VertexLayout *vertex_layout_;
+
+            // Material whose program is still being built by the driver
+            struct PendingMaterial {
+                Resource *resource;
+                GLuint program;
+                GLuint vertex_shader; // 0 when loaded from the cache
+                GLuint fragment_shader;
+                uint64_t key; // Entry of the program in the cache
+            };
+            std::vector<PendingMaterial> pending_materials_;
  
             // Methods to load specific types of resources
-            // Load shaders programs
-            void LoadMaterial(const std::string name, const char *prefix);
+            // Load shaders programs, starting their compilation
+            // Without 'varyings', a fragment program is loaded as well
+            void LoadMaterial(const std::string name, const char *prefix, const std::vector<std::string> &varyings = std::vector<std::string>());
+            // Create a buffer with unpacked vertices converted to the
+            // current vertex format
+            GLuint CreateVertexBuffer(const GLfloat *vertex, int num_vertices);
+            // Create a vertex array object with the layout of the geometry
+            // buffers, in the current vertex format
+            GLuint CreateVertexArray(GLuint array_buffer, GLuint element_array_buffer);
+            // Create the geometry of one level of detail of a torus or sphere
+            Resource *CreateTorusLevel(std::string object_name, float loop_radius, float circle_radius, int num_loop_samples, int num_circle_samples);
+            Resource *CreateSphereLevel(std::string object_name, float radius, int num_samples_theta, int num_samples_phi);
+            // Keep a copy of the unpacked vertices (11 floats each)
+            // and faces of a geometry resource, and compute its bounds
+            void KeepGeometry(Resource *res, const GLfloat *vertex, int num_vertices, const GLuint *face, int num_indices);
+            // Query the locations of the shader inputs of a linked program
+            MaterialLocations GetMaterialLocations(GLuint program);
             // Load a text file into memory (could be source code)
             std::string LoadTextFile(const char *filename);
-            // Load a texture
+            // Load a texture, as an array with a single layer
             void LoadTexture(const std::string name, const char *filename);
+            // Fill the layers of the bound texture array, either with
+            // decoded pixels or with cached compressed blocks
+            void LoadLayers(const std::vector<std::string> &filenames, int width, int height);
+            void LoadCompressedLayers(const std::vector<std::string> &filenames, int width, int height);
+            // Get the sampler assigned to textures by default
+            GLuint GetDefaultSampler(void);
 
     }; // class ResourceManager
 
@@ -12,9 +12,16 @@
 
 namespace game {
 
-SceneGraph::SceneGraph(void){
+SceneGraph::SceneGraph(void) : workers_(WorkerPool::GetDefaultNumWorkers()){
 
     background_color_ = glm::vec3(0.0, 0.0, 0.0);
+    light_position_ = glm::vec3(-0.5, -0.5, 1.5);
+    root_ = NULL;
+    occlusion_culling_ = true;
+    profiler_ = NULL;
+    stream_ = NULL;
+    impostors_ = NULL;
+    lists_.resize(workers_.GetNumThreads());
 }
 
 
@@ -33,9 +40,57 @@ glm::vec3 SceneGraph::GetBackgroundColor(void) const {
     return background_color_;
 }
 
+
+void SceneGraph::SetLightPosition(glm::vec3 position){
+
+    light_position_ = position;
+}
+
+
+glm::vec3 SceneGraph::GetLightPosition(void) const {
+
+    return light_position_;
+}
+
+
+void SceneGraph::SetOcclusionCulling(bool enable){
+
+    occlusion_culling_ = enable;
+}
+
+
+bool SceneGraph::GetOcclusionCulling(void) const {
+
+    return occlusion_culling_;
+}
+
+
+void SceneGraph::SetProfiler(GpuProfiler *profiler){
+
+    profiler_ = profiler;
+}
+
+
+void SceneGraph::SetStreamBuffer(StreamBuffer *stream){
+
+    stream_ = stream;
+}
+
+
+void SceneGraph::SetImpostorAtlas(const ImpostorAtlas *atlas){
+
+    impostors_ = atlas;
+}
+
 void SceneGraph::SetRoot(SceneNode* node) {
 	root_ = node;
 }
+
+
+void SceneGraph::BuildStaticBatches(ResourceManager *resman){
+
+    batcher_.Build(root_, resman);
+}
  
 
 //SceneNode *SceneGraph::CreateNode(std::string node_name, Resource *geometry, Resource *material, Resource *texture){
@@ -89,39 +144,212 @@ SceneNode *SceneGraph::GetNode(std::string node_name) const {
 //}
 
 
-void SceneGraph::Draw(Camera *camera){
+// Maximum number of occluders rasterized per frame
+const int max_occluders_g = 16;
+
+
+// Order occluders by their apparent size from a point of view, largest
+// first
+struct OccluderSize {
+    glm::vec3 eye;
+    OccluderSize(glm::vec3 eye_position) : eye(eye_position) {}
+    float Size(const SceneNode *node) const {
+        float distance = std::max(glm::length(node->GetBoundCenter() - eye), 0.001f);
+        return node->GetBoundRadius() / distance;
+    }
+    bool operator()(const SceneNode *a, const SceneNode *b) const {
+        return Size(a) > Size(b);
+    }
+};
+
+
+// Result of testing a bounding sphere against the view frustum
+typedef enum FrustumTest { Outside, Intersecting, Inside } FrustumTestResult;
+
+static FrustumTestResult TestSphere(const glm::vec4 planes[6], glm::vec3 center, float radius){
+
+    // Empty spheres have nothing to draw, and neither do nodes with an
+    // invalid (NaN) transformation
+    if (!(radius >= 0.0)){
+        return Outside;
+    }
+
+    FrustumTestResult result = Inside;
+    for (int i = 0; i < 6; i++){
+        float distance = glm::dot(glm::vec3(planes[i]), center) + planes[i].w;
+        if (distance < -radius){
+            return Outside;
+        }
+        if (distance < radius){
+            result = Intersecting;
+        }
+    }
+    return result;
+}
+
+
+// Number of visible nodes turned into draw items by one task
+const size_t draw_task_size_g = 64;
 
-	// Clear background
-	glClearColor(background_color_[0],
-		background_color_[1],
-		background_color_[2], 0.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Draw all scene nodes
-	// Initialize stack of nodes
+void SceneGraph::CollectVisible(SceneNode *node, const glm::vec4 planes[6], glm::vec3 eye, DrawList &list){
+
+	// Initialize stack of nodes, along with whether they are known to be
+	// entirely inside the view
 	std::stack<SceneNode *> stck;
-	stck.push(root_);
-	// Initialize stack of transformations
-	std::stack<glm::mat4> transf;
-	transf.push(glm::mat4(1.0));
+	std::stack<bool> inside;
+	stck.push(node);
+	inside.push(false);
 	// Traverse hierarchy
 	while (stck.size() > 0) {
 		// Get next node to be processed and pop it from the stack
 		SceneNode *current = stck.top();
 		stck.pop();
-		// Get transformation corresponding to the parent of the next node
-		glm::mat4 parent_transf = transf.top();
-		transf.pop();
-		// Draw node based on parent transformation
-		glm::mat4 current_transf = current->Draw(camera, parent_transf);
-		// Push children of the node to the stack, along with the node's
-		// transformation
+		bool current_inside = inside.top();
+		inside.pop();
+		// Hidden nodes hide their children as well
+		if (!current->IsVisible()) {
+			continue;
+		}
+		// Skip the node and its children if they are all out of view;
+		// once a subtree is entirely inside, its children need no test
+		if (!current_inside) {
+			FrustumTestResult result = TestSphere(planes, current->GetSubtreeBoundCenter(), current->GetSubtreeBoundRadius());
+			if (result == Outside) {
+				continue;
+			}
+			current_inside = (result == Inside);
+		}
+		// Far subtrees with a picture show it, and past the fading band
+		// their nodes are not drawn anymore
+		if (impostors_ && current->GetImpostor()) {
+			float distance = glm::length(current->GetSubtreeBoundCenter() - eye);
+			if (distance > impostors_->GetFadeStart()) {
+				list.impostors.push_back(current);
+				if (distance >= impostors_->GetFadeEnd()) {
+					continue;
+				}
+			}
+		}
+		// Keep the node, unless only its children are in view; batched
+		// nodes are drawn by their batch but may still hide other nodes
+		if (current_inside || (TestSphere(planes, current->GetBoundCenter(), current->GetBoundRadius()) != Outside)) {
+			if (!current->IsBatched()) {
+				list.visible.push_back(current);
+			}
+			if (current->IsOccluder()) {
+				list.occluders.push_back(current);
+			}
+		}
+		// Push children of the node to the stack
 		for (std::vector<SceneNode *>::const_iterator it = current->children_begin();
 			it != current->children_end(); it++) {
 			stck.push(*it);
-			transf.push(current_transf);
+			inside.push(current_inside);
+		}
+	}
+}
+
+
+void SceneGraph::Draw(Camera *camera, float time){
+
+	// Clear background
+	glClearColor(background_color_[0],
+		background_color_[1],
+		background_color_[2], 0.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Set camera matrices, light and time once for the whole frame, so that
+	// every object sees the same values
+	frame_.Update(camera, light_position_, time, stream_);
+
+	glm::vec4 planes[6];
+	camera->GetFrustumPlanes(planes);
+
+	for (size_t i = 0; i < lists_.size(); i++) {
+		lists_[i].visible.clear();
+		lists_[i].occluders.clear();
+		lists_[i].impostors.clear();
+		lists_[i].queue.Clear();
+	}
+
+	// Place all nodes in the world, gather their bounds and collect the
+	// ones in view; each child of the root is a separate task, and
+	// whole subtrees outside of the view are skipped
+	// Nodes have a single parent, so that no node is in two tasks
+	root_->UpdateNodeBounds(glm::mat4(1.0));
+	if (root_->IsVisible()) {
+		const std::vector<SceneNode *> &children = root_->children;
+		glm::mat4 root_transf = root_->GetWorldTransform();
+		workers_.Run(children.size(), [&](size_t task, size_t thread) {
+			children[task]->UpdateBounds(root_transf);
+			CollectVisible(children[task], planes, camera->GetPosition(), lists_[thread]);
+		});
+		root_->MergeChildBounds();
+
+		if (TestSphere(planes, root_->GetBoundCenter(), root_->GetBoundRadius()) != Outside) {
+			if (!root_->IsBatched()) {
+				lists_[0].visible.push_back(root_);
+			}
+			if (root_->IsOccluder()) {
+				lists_[0].occluders.push_back(root_);
+			}
+		}
+	}
+
+	visible_.clear();
+	occluders_.clear();
+	for (size_t i = 0; i < lists_.size(); i++) {
+		visible_.insert(visible_.end(), lists_[i].visible.begin(), lists_[i].visible.end());
+		occluders_.insert(occluders_.end(), lists_[i].occluders.begin(), lists_[i].occluders.end());
+	}
+
+	// Rasterize the occluders that cover most of the screen, and skip the
+	// nodes hidden behind them
+	bool occlusion = occlusion_culling_ && (occluders_.size() > 0);
+	if (occlusion) {
+		glm::vec3 eye = camera->GetPosition();
+		size_t num_occluders = std::min(occluders_.size(), (size_t) max_occluders_g);
+		std::partial_sort(occluders_.begin(), occluders_.begin() + num_occluders, occluders_.end(), OccluderSize(eye));
+		occlusion_.Clear(camera->GetProjectionMatrix() * camera->GetViewMatrix(), camera->GetNearClip());
+		for (size_t i = 0; i < num_occluders; i++) {
+			occlusion_.AddOccluderBox(occluders_[i]->GetWorldMatrix(), occluders_[i]->GetBoundMin(), occluders_[i]->GetBoundMax());
 		}
 	}
+
+	// Collect draw items of the remaining nodes, in parallel as well, each
+	// thread filling its own queue
+	size_t num_tasks = (visible_.size() + draw_task_size_g - 1) / draw_task_size_g;
+	workers_.Run(num_tasks, [&](size_t task, size_t thread) {
+		size_t end = std::min(visible_.size(), (task + 1)*draw_task_size_g);
+		for (size_t i = task*draw_task_size_g; i < end; i++) {
+			SceneNode *current = visible_[i];
+			if (occlusion && !current->IsOccluder() &&
+				!occlusion_.IsBoxVisible(current->GetWorldMatrix(), current->GetBoundMin(), current->GetBoundMax())) {
+				continue;
+			}
+			current->Draw(camera, &lists_[thread].queue);
+		}
+	});
+
+	// Pictures of the faraway subtrees, few enough to add in one go
+	for (size_t i = 0; i < lists_.size(); i++) {
+		for (size_t j = 0; j < lists_[i].impostors.size(); j++) {
+			SceneNode *current = lists_[i].impostors[j];
+			if (occlusion && !occlusion_.IsBoxVisible(current->GetWorldMatrix(), current->GetBoundMin(), current->GetBoundMax())) {
+				continue;
+			}
+			impostors_->Draw(current, camera, &lists_[i].queue);
+		}
+	}
+
+	// Draw the items grouped by render state
+	queue_.Clear();
+	for (size_t i = 0; i < lists_.size(); i++) {
+		queue_.Append(lists_[i].queue);
+	}
+	queue_.Sort();
+	queue_.Submit(stream_, profiler_);
 }
 
 
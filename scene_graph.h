@@ -11,6 +11,12 @@
 #include "resource.h"
 #include "resource_manager.h"
 #include "camera.h"
+#include "render_queue.h"
+#include "frame_uniforms.h"
+#include "occlusion_buffer.h"
+#include "static_batcher.h"
+#include "impostor_atlas.h"
+#include "worker_pool.h"
 
 namespace game {
 
@@ -26,6 +32,53 @@ namespace game {
 
 			SceneNode* root_;
 
+			// Draw items collected while traversing the scene
+			RenderQueue queue_;
+
+			// Position of the light in world coordinates
+			glm::vec3 light_position_;
+
+			// Values shared by all draws of a frame
+			FrameUniforms frame_;
+
+			// Nodes in view in the current frame, and the occluders
+			// among them
+			std::vector<SceneNode *> visible_;
+			std::vector<SceneNode *> occluders_;
+
+			// Depth of the occluders, used to skip hidden nodes
+			OcclusionBuffer occlusion_;
+			bool occlusion_culling_;
+
+			// Profiler measuring the passes of the scene, if any
+			GpuProfiler *profiler_;
+
+			// Buffer receiving the data of each frame
+			StreamBuffer *stream_;
+
+			// Pictures drawn instead of faraway subtrees, if any
+			const ImpostorAtlas *impostors_;
+
+			// Merged geometry of the static nodes
+			StaticBatcher batcher_;
+
+			// Nodes and draw items gathered by one thread
+			struct DrawList {
+				std::vector<SceneNode *> visible;
+				std::vector<SceneNode *> occluders;
+				std::vector<SceneNode *> impostors; // Drawn as pictures
+				RenderQueue queue;
+			};
+
+			// Threads building the draw items, and one list per thread
+			WorkerPool workers_;
+			std::vector<DrawList> lists_;
+
+			// Add the nodes of the subtree of 'node' that are in view to
+			// 'list', and the subtrees far enough from 'eye' to be drawn as
+			// impostors; safe to call on disjoint subtrees in parallel
+			void CollectVisible(SceneNode *node, const glm::vec4 planes[6], glm::vec3 eye, DrawList &list);
+
         public:
             typedef std::vector<SceneNode *>::const_iterator const_iterator;
 
@@ -35,6 +88,27 @@ namespace game {
             // Background color
             void SetBackgroundColor(glm::vec3 color);
             glm::vec3 GetBackgroundColor(void) const;
+
+            // Light position
+            void SetLightPosition(glm::vec3 position);
+            glm::vec3 GetLightPosition(void) const;
+
+            // Skip nodes hidden behind occluders (enabled by default)
+            void SetOcclusionCulling(bool enable);
+            bool GetOcclusionCulling(void) const;
+
+            // Measure each draw pass with 'profiler' (NULL for none); only
+            // used in builds with GPU_PROFILER
+            void SetProfiler(GpuProfiler *profiler);
+
+            // Buffer receiving the uniforms and instance data of each
+            // frame; required before drawing, and shared with the other
+            // systems drawing the frame
+            void SetStreamBuffer(StreamBuffer *stream);
+
+            // Draw the subtrees that have an impostor in 'atlas' as a
+            // picture when they are far away (NULL to always draw nodes)
+            void SetImpostorAtlas(const ImpostorAtlas *atlas);
             
             // Create a scene node from two resources
             SceneNode *CreateNode(std::string node_name, Resource *geometry, Resource *material, Resource *texture = NULL);
@@ -49,7 +123,11 @@ namespace game {
             std::vector<SceneNode *>::const_iterator end() const;
 
             // Draw the entire scene
-            void Draw(Camera *camera);
+            // The children of the root are placed, culled and turned into
+            // draw items by several threads; only the calling thread
+            // issues OpenGL calls
+            // 'time' is the animation time, in seconds, given to shaders
+            void Draw(Camera *camera, float time);
 
 
             // Update entire scene
@@ -57,6 +135,10 @@ namespace game {
 
 			void SetRoot(SceneNode* node);
 
+			// Merge the static nodes of the scene, so that they are drawn
+			// with a few calls; call again after static nodes change
+			void BuildStaticBatches(ResourceManager *resman);
+
     }; // class SceneGraph
 
 } // namespace game
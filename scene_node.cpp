@@ -7,6 +7,7 @@
 #include <algorithm>
 
 #include "scene_node.h"
+#include "prefab_mesh.h"
 
 namespace game {
 
@@ -28,34 +29,39 @@ SceneNode::SceneNode(const std::string name, const Resource *geometry, const Res
 	side_ = glm::normalize(side_);
 
     // Set geometry
-    if (geometry->GetType() == PointSet){
-        mode_ = GL_POINTS;
-    } else if (geometry->GetType() == Mesh){
-        mode_ = GL_TRIANGLES;
-    } else {
-        throw(std::invalid_argument(std::string("Invalid type of geometry")));
-    }
-
-    array_buffer_ = geometry->GetArrayBuffer();
-    element_array_buffer_ = geometry->GetElementArrayBuffer();
-    size_ = geometry->GetSize();
+    SetGeometry(geometry);
 
     // Set material (shader program)
     if (material->GetType() != Material){
         throw(std::invalid_argument(std::string("Invalid type of material")));
     }
 
-    material_ = material->GetResource();
+    material_ = material;
 
     // Set texture
     if (texture){
         texture_ = texture->GetResource();
+        sampler_ = texture->GetSampler();
+        layer_ = texture->GetLayer();
     } else {
         texture_ = 0;
+        sampler_ = 0;
+        layer_ = 0;
     }
 
     // Other attributes
     scale_ = glm::vec3(1.0, 1.0, 1.0);
+    world_transf_ = glm::mat4(1.0);
+    world_center_ = glm::vec3(0.0, 0.0, 0.0);
+    world_radius_ = -1.0;
+    subtree_center_ = glm::vec3(0.0, 0.0, 0.0);
+    subtree_radius_ = -1.0;
+    occluder_ = false;
+    static_ = false;
+    pass_ = ObjectPass;
+    batched_ = false;
+    impostor_ = NULL;
+    prefab_ = NULL;
 
 	parent = NULL;
 }
@@ -163,17 +169,59 @@ GLuint SceneNode::GetElementArrayBuffer(void) const {
 }
 
 
+GLuint SceneNode::GetVertexArray(void) const {
+
+    return vertex_array_;
+}
+
+
 GLsizei SceneNode::GetSize(void) const {
 
     return size_;
 }
 
 
+GLenum SceneNode::GetIndexType(void) const {
+
+    return index_type_;
+}
+
+
 GLuint SceneNode::GetMaterial(void) const {
 
+    return material_->GetResource();
+}
+
+
+const Resource *SceneNode::GetMaterialResource(void) const {
+
     return material_;
 }
 
+
+const Resource *SceneNode::GetGeometry(void) const {
+
+    return geometry_;
+}
+
+
+GLuint SceneNode::GetTexture(void) const {
+
+    return texture_;
+}
+
+
+GLuint SceneNode::GetSampler(void) const {
+
+    return sampler_;
+}
+
+
+int SceneNode::GetLayer(void) const {
+
+    return layer_;
+}
+
 glm::vec3 SceneNode::GetForward(void) const {
 
 	glm::vec3 current_forward = orientation_ * forward_;
@@ -192,123 +240,353 @@ glm::vec3 SceneNode::GetSide(void) const {
 }
 
 
-glm::mat4 SceneNode::Draw(Camera *camera, glm::mat4 parent_transf){
+// Grow sphere (center, radius) so that it also encloses the other sphere
+// A negative radius denotes an empty sphere; spheres of nodes with an
+// invalid (NaN) transformation are ignored as well
+static void MergeSpheres(glm::vec3 &center, float &radius, glm::vec3 other_center, float other_radius){
+
+    if (!(other_radius >= 0.0)){
+        return;
+    }
+    if (!(radius >= 0.0)){
+        center = other_center;
+        radius = other_radius;
+        return;
+    }
+
+    glm::vec3 offset = other_center - center;
+    float distance = glm::length(offset);
+    if (distance + other_radius <= radius){
+        // The other sphere is already enclosed
+        return;
+    }
+    if (distance + radius <= other_radius){
+        // The other sphere encloses this one
+        center = other_center;
+        radius = other_radius;
+        return;
+    }
+
+    float new_radius = (distance + radius + other_radius) * 0.5f;
+    center += offset * ((new_radius - radius) / distance);
+    radius = new_radius;
+}
+
+
+void SceneNode::UpdateBounds(const glm::mat4 &parent_transf){
 
-	if (draw) {
-		if ((array_buffer_ > 0) && (material_ > 0)) {
-			// Select proper material (shader program)
-			glUseProgram(material_);
+    UpdateNodeBounds(parent_transf);
 
-			// Set geometry to draw
-			glBindBuffer(GL_ARRAY_BUFFER, array_buffer_);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer_);
+    // Hidden nodes hide their children as well
+    if (!draw){
+        return;
+    }
 
-			// Set globals for camera
-			camera->SetupShader(material_);
+    for (std::vector<SceneNode *>::const_iterator it = children.begin(); it != children.end(); it++){
+        (*it)->UpdateBounds(world_transf_);
+    }
+    MergeChildBounds();
+}
 
-			// Set world matrix and other shader input variables
-			glm::mat4 transf = SetupShader(material_, parent_transf);
 
-			// Draw geometry
-			if (mode_ == GL_POINTS) {
-				glDrawArrays(mode_, 0, size_);
-			}
-			else {
-				glDrawElements(mode_, size_, GL_UNSIGNED_INT, 0);
-			}
+void SceneNode::UpdateNodeBounds(const glm::mat4 &parent_transf){
 
-			return transf;
-		}
-		else {
-			glm::mat4 rotation = glm::mat4_cast(orientation_);
-			glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
-			glm::mat4 transf = parent_transf * translation * rotation;
-			return transf;
-		}
-	}
+    // Transformation of the node, which is passed down to the children
+    glm::mat4 rotation = glm::mat4_cast(orientation_);
+    glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
+    world_transf_ = parent_transf * translation * rotation;
+
+    // Sphere of the geometry, scaled by the largest axis of the world
+    // transformation
+    world_radius_ = -1.0;
+    if (draw && (vertex_array_ > 0) && (bound_radius_ >= 0.0)){
+        glm::mat4 world = world_transf_ * glm::scale(glm::mat4(1.0), scale_);
+        float axis_scale = std::max(glm::length(glm::vec3(world[0])),
+                           std::max(glm::length(glm::vec3(world[1])),
+                                    glm::length(glm::vec3(world[2]))));
+        world_center_ = glm::vec3(world * glm::vec4(bound_center_, 1.0));
+        world_radius_ = bound_radius_ * axis_scale;
+    }
+
+    subtree_center_ = world_center_;
+    subtree_radius_ = world_radius_;
 }
 
 
+void SceneNode::MergeChildBounds(void){
 
+    if (!draw){
+        return;
+    }
 
+    for (std::vector<SceneNode *>::const_iterator it = children.begin(); it != children.end(); it++){
+        MergeSpheres(subtree_center_, subtree_radius_, (*it)->subtree_center_, (*it)->subtree_radius_);
+    }
+}
 
-void SceneNode::Update(void){
 
+// Relative change of screen size needed to switch between two levels of
+// detail, so that nodes near a threshold do not alternate every frame
+const float lod_hysteresis_g = 0.1;
 
-	
-    // Do nothing for this generic type of scene node
+
+void SceneNode::SelectLevel(Camera *camera){
+
+    float size = camera->GetScreenSize(world_center_, world_radius_);
+
+    // Finest level allowed by a given screen size
+    int finer = 0, coarser = 0;
+    for (int i = 0; i < (int) levels_.size(); i++){
+        if (size / (1.0f + lod_hysteresis_g) < levels_[i].min_screen_size){
+            finer = i + 1;
+        }
+        if (size / (1.0f - lod_hysteresis_g) < levels_[i].min_screen_size){
+            coarser = i + 1;
+        }
+    }
+    finer = std::min(finer, (int) levels_.size() - 1);
+    coarser = std::min(coarser, (int) levels_.size() - 1);
+
+    // Only move past a threshold once the size is clearly beyond it
+    int level = level_;
+    if (finer < level_){
+        level = finer;
+    } else if (coarser > level_){
+        level = coarser;
+    }
+
+    if (level != level_){
+        const Resource *geometry = levels_[level].geometry;
+        array_buffer_ = geometry->GetArrayBuffer();
+        element_array_buffer_ = geometry->GetElementArrayBuffer();
+        vertex_array_ = geometry->GetVertexArray();
+        size_ = geometry->GetSize();
+        index_type_ = geometry->GetIndexType();
+        level_ = level;
+    }
 }
 
 
-glm::mat4 SceneNode::SetupShader(GLuint program, glm::mat4 parent_transf){
+void SceneNode::Draw(Camera *camera, RenderQueue *queue){
 
-    // Set attributes for shaders
-    GLint vertex_att = glGetAttribLocation(program, "vertex");
-    glVertexAttribPointer(vertex_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(vertex_att);
+    if (levels_.size() > 1){
+        SelectLevel(camera);
+    }
 
-    GLint normal_att = glGetAttribLocation(program, "normal");
-    glVertexAttribPointer(normal_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (3*sizeof(GLfloat)));
-    glEnableVertexAttribArray(normal_att);
+    if (draw && (vertex_array_ > 0) && (material_->GetResource() > 0)){
+        DrawItem item;
+        item.program = material_->GetResource();
+        item.locations = &material_->GetLocations();
+        item.texture = texture_;
+        item.layer = (GLfloat) layer_;
+        // A sampler set on the material overrides the one of the texture
+        item.sampler = material_->GetSampler() ? material_->GetSampler() : sampler_;
+        item.vertex_array = vertex_array_;
+        item.mode = mode_;
+        item.size = size_;
+        item.index_type = index_type_;
+
+        // World transformation
+        // Scaling only applies to the node itself, not to its children
+        glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
+        item.world_matrix = world_transf_ * scaling;
+
+        // Normal matrix
+        item.normal_matrix = glm::transpose(glm::inverse(world_transf_));
+
+        // Current position of the moving parts of a baked prefab
+        item.palette = NULL;
+        item.palette_size = (GLsizei) palette_.size();
+        if (!palette_.empty()){
+            prefab_->GetPalette(&palette_[0]);
+            item.palette = &palette_[0];
+        }
+
+        // Sort by state first, and by distance to the camera last
+        float distance = glm::length(glm::vec3(world_transf_[3]) - camera->GetPosition());
+        item.key = RenderQueue::MakeKey(pass_, item.program, texture_, vertex_array_, distance / camera->GetFarClip());
+
+        queue->Add(item);
+    }
+}
 
-    GLint color_att = glGetAttribLocation(program, "color");
-    glVertexAttribPointer(color_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (6*sizeof(GLfloat)));
-    glEnableVertexAttribArray(color_att);
 
-    GLint tex_att = glGetAttribLocation(program, "uv");
-    glVertexAttribPointer(tex_att, 2, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (9*sizeof(GLfloat)));
-    glEnableVertexAttribArray(tex_att);
+glm::vec3 SceneNode::GetBoundCenter(void) const {
 
-    // World transformation
-    glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
-    glm::mat4 rotation = glm::mat4_cast(orientation_);
-    glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
-	glm::mat4 transf = parent_transf * translation * rotation;// * scaling;
-	glm::mat4 local_transf = transf * scaling;
+    return world_center_;
+}
+
+
+float SceneNode::GetBoundRadius(void) const {
+
+    return world_radius_;
+}
+
+
+glm::vec3 SceneNode::GetSubtreeBoundCenter(void) const {
+
+    return subtree_center_;
+}
+
+
+float SceneNode::GetSubtreeBoundRadius(void) const {
+
+    return subtree_radius_;
+}
 
-    GLint world_mat = glGetUniformLocation(program, "world_mat");
-    glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local_transf));
 
-    // Normal matrix
-    glm::mat4 normal_matrix = glm::transpose(glm::inverse(transf));
-    GLint normal_mat = glGetUniformLocation(program, "normal_mat");
-    glUniformMatrix4fv(normal_mat, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+glm::vec3 SceneNode::GetBoundMin(void) const {
+
+    return bound_min_;
+}
+
+
+glm::vec3 SceneNode::GetBoundMax(void) const {
+
+    return bound_max_;
+}
+
+
+glm::mat4 SceneNode::GetWorldMatrix(void) const {
+
+    return world_transf_ * glm::scale(glm::mat4(1.0), scale_);
+}
+
+
+glm::mat4 SceneNode::GetWorldTransform(void) const {
+
+    return world_transf_;
+}
+
+
+void SceneNode::SetOccluder(bool occluder){
+
+    occluder_ = occluder;
+}
+
+
+void SceneNode::SetStatic(bool is_static){
+
+    static_ = is_static;
+}
 
-    // Texture
-    if (texture_){
-        GLint tex = glGetUniformLocation(program, "texture_map");
-        glUniform1i(tex, 0); // Assign the first texture to the map
-        glActiveTexture(GL_TEXTURE0); 
-        glBindTexture(GL_TEXTURE_2D, texture_); // First texture we bind
-        // Define texture interpolation
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+bool SceneNode::IsStatic(void) const {
+
+    return static_;
+}
 
-		//if (this->name_ == "Ground") {
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		//}
 
+void SceneNode::SetDrawPass(DrawPass pass){
 
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    pass_ = pass;
+    for (size_t i = 0; i < children.size(); i++){
+        children[i]->SetDrawPass(pass);
     }
+}
+
+
+DrawPass SceneNode::GetDrawPass(void) const {
+
+    return pass_;
+}
+
+
+void SceneNode::SetBatched(bool batched){
+
+    batched_ = batched;
+}
+
+
+bool SceneNode::IsBatched(void) const {
+
+    return batched_;
+}
+
+
+int SceneNode::GetLevel(void) const {
+
+    return level_;
+}
+
+
+void SceneNode::SetImpostor(const Impostor *impostor){
+
+    impostor_ = impostor;
+}
+
+
+const Impostor *SceneNode::GetImpostor(void) const {
+
+    return impostor_;
+}
+
+
+void SceneNode::SetPrefabMesh(const PrefabMesh *prefab){
+
+    SetGeometry(prefab->GetGeometry());
+    material_ = prefab->GetMaterial();
+    orientation_ = prefab->GetOrientation();
+    scale_ = glm::vec3(1.0, 1.0, 1.0);
+    prefab_ = prefab;
+    palette_.resize(prefab->GetPaletteSize());
+}
+
+
+const PrefabMesh *SceneNode::GetPrefabMesh(void) const {
+
+    return prefab_;
+}
+
+
+bool SceneNode::IsOccluder(void) const {
+
+    return occluder_;
+}
+
+
+bool SceneNode::IsVisible(void) const {
+
+    return draw;
+}
 
-    // Timer
-    GLint timer_var = glGetUniformLocation(program, "timer");
-    double current_time = glfwGetTime();
-    glUniform1f(timer_var, (float) current_time);
 
-	return transf;
+void SceneNode::Update(void){
+
+
+	
+    // Do nothing for this generic type of scene node
 }
 
 
+void SceneNode::SetGeometry(const Resource *geometry){
+
+    if (geometry->GetType() == PointSet){
+        mode_ = GL_POINTS;
+    } else if (geometry->GetType() == Mesh){
+        mode_ = GL_TRIANGLES;
+    } else {
+        throw(std::invalid_argument(std::string("Invalid type of geometry")));
+    }
+
+    array_buffer_ = geometry->GetArrayBuffer();
+    element_array_buffer_ = geometry->GetElementArrayBuffer();
+    vertex_array_ = geometry->GetVertexArray();
+    size_ = geometry->GetSize();
+    index_type_ = geometry->GetIndexType();
+    geometry_ = geometry;
+    bound_center_ = geometry->GetBoundCenter();
+    bound_radius_ = geometry->GetBoundRadius();
+    bound_min_ = geometry->GetBoundMin();
+    bound_max_ = geometry->GetBoundMax();
+    levels_ = geometry->GetLevels();
+    level_ = 0;
+}
+
 
 void SceneNode::SetMaterial(const Resource *material) {
 
-	this->material_ = material->GetResource();
+	this->material_ = material;
 
 
 }
@@ -316,11 +594,24 @@ void SceneNode::SetMaterial(const Resource *material) {
 void SceneNode::SetTexture(const Resource *texture) {
 
 	this->texture_ = texture->GetResource();
+	this->sampler_ = texture->GetSampler();
+	this->layer_ = texture->GetLayer();
 
+}
 
+void SceneNode::SetTexture(GLuint texture, GLuint sampler, int layer) {
+
+	texture_ = texture;
+	sampler_ = sampler;
+	layer_ = layer;
 }
 
 void SceneNode::AddChild(SceneNode *node) {
+	// The world transformation and the bounds are kept on the node, and
+	// the subtrees are collected in parallel: a node has one place only
+	if (node->parent) {
+		throw(std::invalid_argument(std::string("Node ") + node->GetName() + std::string(" already has a parent")));
+	}
 	children.push_back(node);
 	node->parent = this;
 }
@@ -340,6 +631,7 @@ void SceneNode::removeChild(SceneNode * child) {
 	std::vector<SceneNode*>::iterator position = std::find(children.begin(), children.end(), child);
 	if (position != children.end()) {
 		children.erase(position);
+		child->parent = NULL;
 	}
 
 }
@@ -12,9 +12,13 @@
 
 #include "resource.h"
 #include "camera.h"
+#include "render_queue.h"
 
 namespace game {
 
+    struct Impostor;
+    class PrefabMesh;
+
     // Class that manages one object in a scene 
     class SceneNode {
 
@@ -48,9 +52,72 @@ namespace game {
             void Rotate(glm::quat rot);
             void Scale(glm::vec3 scale);
 
+            // Compute the world transformation and the bounding spheres of
+            // the node and of all its visible children
+            // Called once per frame before the node is drawn
+            void UpdateBounds(const glm::mat4 &parent_transf);
+            // The two steps of UpdateBounds, for callers that update the
+            // children themselves: the node alone, then the subtree sphere
+            // once the children are up to date
+            void UpdateNodeBounds(const glm::mat4 &parent_transf);
+            void MergeChildBounds(void);
+
             // Draw the node according to scene parameters in 'camera'
-            // variable
-            virtual glm::mat4 Draw(Camera *camera, glm::mat4 parent_transf);
+            // variable: the node is added to 'queue', which issues the
+            // actual OpenGL calls
+            // Uses the world transformation computed by UpdateBounds
+            virtual void Draw(Camera *camera, RenderQueue *queue);
+
+            // Bounding spheres in world coordinates, of the node alone and
+            // of the node together with its children
+            // The radius is negative when there is nothing to draw
+            glm::vec3 GetBoundCenter(void) const;
+            float GetBoundRadius(void) const;
+            glm::vec3 GetSubtreeBoundCenter(void) const;
+            float GetSubtreeBoundRadius(void) const;
+            // Bounding box of the geometry, in object space
+            glm::vec3 GetBoundMin(void) const;
+            glm::vec3 GetBoundMax(void) const;
+            // World transformation of the geometry, including scaling
+            glm::mat4 GetWorldMatrix(void) const;
+            // World transformation passed to the children, without scaling
+            glm::mat4 GetWorldTransform(void) const;
+
+            // Static nodes never move once placed, so that their geometry
+            // can be merged with the one of other static nodes
+            void SetStatic(bool is_static);
+            bool IsStatic(void) const;
+            // Pass the node is drawn in, set on the node and on its current
+            // children (ObjectPass by default)
+            void SetDrawPass(DrawPass pass);
+            DrawPass GetDrawPass(void) const;
+            // Batched nodes are drawn as part of a merged geometry instead
+            // of on their own
+            void SetBatched(bool batched);
+            bool IsBatched(void) const;
+
+            // Level of detail drawn in the last frame (0 is the finest)
+            int GetLevel(void) const;
+
+            // Picture of the node and its children, drawn instead of them
+            // when they are far away (NULL for none)
+            void SetImpostor(const Impostor *impostor);
+            const Impostor *GetImpostor(void) const;
+
+            // Draw a prefab baked into a single mesh, instead of building
+            // it from child nodes; the node takes the orientation the root
+            // of the prefab had, and no scaling, which is part of the mesh
+            void SetPrefabMesh(const PrefabMesh *prefab);
+            const PrefabMesh *GetPrefabMesh(void) const;
+
+            // Occluders hide the nodes behind them from the camera, so
+            // that these are not drawn; the geometry of an occluder must
+            // fill its bounding box
+            void SetOccluder(bool occluder);
+            bool IsOccluder(void) const;
+
+            // Whether the node and its children should be drawn
+            bool IsVisible(void) const;
 
 			glm::vec3 GetForward(void) const;
 			glm::vec3 GetSide(void) const;
@@ -66,16 +133,28 @@ namespace game {
             GLenum GetMode(void) const;
             GLuint GetArrayBuffer(void) const;
             GLuint GetElementArrayBuffer(void) const;
+            GLuint GetVertexArray(void) const;
             GLsizei GetSize(void) const;
+            GLenum GetIndexType(void) const;
             GLuint GetMaterial(void) const;
+            const Resource *GetMaterialResource(void) const;
+            const Resource *GetGeometry(void) const;
+            GLuint GetTexture(void) const;
+            GLuint GetSampler(void) const;
+            int GetLayer(void) const;
 			void removeChild(SceneNode* child);
 
+            // Replace the geometry of the node, with its levels of detail
+            void SetGeometry(const Resource *geometry);
 			void SetMaterial(const Resource *material);
 			void SetTexture(const Resource *texture);
+			void SetTexture(GLuint texture, GLuint sampler, int layer = 0);
 
 			SceneNode *parent;
 			std::vector<SceneNode* > children;
 
+			// Attach a node without a parent; detach it with removeChild
+			// before attaching it somewhere else
 			void AddChild(SceneNode *node);
 			std::vector<SceneNode *>::const_iterator children_begin() const;
 			std::vector<SceneNode *>::const_iterator children_end() const;
@@ -83,22 +162,47 @@ namespace game {
 			bool isSafe();
 
         protected:
+            // Choose the level of detail matching the size of the node on
+            // the screen, and use its geometry
+            void SelectLevel(Camera *camera);
+
             std::string name_; // Name of the scene node
             GLuint array_buffer_; // References to geometry: vertex and array buffers
             GLuint element_array_buffer_;
+            GLuint vertex_array_; // Vertex layout of the geometry
+            const Resource *geometry_; // Geometry the node was created with
             GLenum mode_; // Type of geometry
             GLsizei size_; // Number of primitives in geometry
-            GLuint material_; // Reference to shader program
+            GLenum index_type_; // Type of the element array
+            const Resource *material_; // Reference to shader program
             GLuint texture_; // Reference to texture resource
+            GLuint sampler_; // Sampling state of the texture
+            int layer_; // Layer of the texture array
             glm::vec3 position_; // Position of node
             glm::quat orientation_; // Orientation of node
             glm::vec3 scale_; // Scale of node
+            glm::vec3 bound_center_; // Bounding sphere of the geometry, in
+            float bound_radius_;     // object space
+            glm::vec3 bound_min_; // Bounding box of the geometry, in object
+            glm::vec3 bound_max_; // space
+            std::vector<LevelOfDetail> levels_; // Levels of detail of the geometry
+            int level_; // Level of detail drawn in the last frame
+            const Impostor *impostor_; // Picture of the subtree, if any
+            const PrefabMesh *prefab_; // Baked prefab drawn, if any
+            std::vector<glm::mat4> palette_; // Moving parts of the prefab,
+                                             // kept until the queue is submitted
+            bool occluder_; // Whether the node hides the nodes behind it
+            bool static_; // Whether the node never moves
+            DrawPass pass_; // Pass the node is drawn in
+            bool batched_; // Whether the node is drawn as part of a batch
+            glm::mat4 world_transf_; // Transformation without scaling, set by UpdateBounds
+            glm::vec3 world_center_; // Bounding sphere of the node in world space
+            float world_radius_;
+            glm::vec3 subtree_center_; // Bounding sphere including the children
+            float subtree_radius_;
 
 			float radius;
 
-            // Set matrices that transform the node in a shader program
-            glm::mat4 SetupShader(GLuint program, glm::mat4 parent_transf);
-
 			glm::vec3 forward_; // Initial forward vector
 			glm::vec3 side_; // Initial side vector
 
@@ -1,10 +1,13 @@
-#version 130
+#version 140
 
 // Attributes passed from the vertex shader
 in vec3 position_interp;
 in vec3 normal_interp;
 in vec3 light_pos;
 
+// Color of the fragment
+out vec4 frag_color;
+
 // Material attributes (constants)
 vec4 ambient_color = vec4(0.1, 0.1, 0.0, 1.0);
 vec4 diffuse_color = vec4(0.5, 0.5, 0.0, 1.0);
@@ -42,14 +45,14 @@ void main()
     float Is = pow(spec_angle_cos, phong_exponent);
         
     // Assign light to the fragment
-    gl_FragColor = ambient_color + Id*diffuse_color + Is*specular_color;
+    frag_color = ambient_color + Id*diffuse_color + Is*specular_color;
                     
     // For debug, we can display the different values
-    //gl_FragColor = ambient_color;
-    //gl_FragColor = diffuse_color;
-    //gl_FragColor = specular_color;
-    //gl_FragColor = color_interp;
-    //gl_FragColor = vec4(N.xyz, 1.0);
-    //gl_FragColor = vec4(L.xyz, 1.0);
-    //gl_FragColor = vec4(V.xyz, 1.0);
+    //frag_color = ambient_color;
+    //frag_color = diffuse_color;
+    //frag_color = specular_color;
+    //frag_color = color_interp;
+    //frag_color = vec4(N.xyz, 1.0);
+    //frag_color = vec4(L.xyz, 1.0);
+    //frag_color = vec4(V.xyz, 1.0);
 }
@@ -1,32 +1,37 @@
-#version 130
+#version 140
 
 // Vertex buffer
 in vec3 vertex;
 in vec3 normal;
 in vec3 color;
 
-// Uniform (global) buffer
-uniform mat4 world_mat;
-uniform mat4 view_mat;
-uniform mat4 projection_mat;
-uniform mat4 normal_mat;
+// Instance buffer, one entry per drawn node
+in mat4 world_mat;
+in mat4 normal_mat;
+
+// Per-frame uniform buffer, shared by all programs
+// Keep in sync with FrameBlock in frame_uniforms.h
+layout(std140) uniform FrameBlock {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    vec4 light_position;
+    float timer;
+};
 
 // Attributes forwarded to the fragment shader
 out vec3 position_interp;
 out vec3 normal_interp;
 out vec3 light_pos;
 
-// Material attributes (constants)
-vec3 light_position = vec3(-0.5, -0.5, 1.5);
-
 
 void main()
 {
-    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+    gl_Position = view_projection_mat * world_mat * vec4(vertex, 1.0);
 
     position_interp = vec3(view_mat * world_mat * vec4(vertex, 1.0));
 
     normal_interp = vec3(normal_mat * vec4(normal, 0.0));
 
-    light_pos = vec3(view_mat * vec4(light_position, 1.0));
+    light_pos = vec3(view_mat * light_position);
 }
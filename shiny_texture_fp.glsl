@@ -1,14 +1,18 @@
-#version 130
+#version 140
 
 // Attributes passed from the vertex shader
 in vec3 position_interp;
 in vec3 normal_interp;
 in vec4 color_interp;
 in vec2 uv_interp;
+flat in float layer_interp;
 in vec3 light_pos;
 
+// Color of the fragment
+out vec4 frag_color;
+
 // Uniform (global) buffer
-uniform sampler2D texture_map;
+uniform sampler2DArray texture_map;
 
 // Material attributes (constants)
 vec4 ambient_color = vec4(0.1, 0.1, 0.0, 1.0);
@@ -45,11 +49,11 @@ void main()
     float spec_angle_cos = max(dot(N, H), 0.0);
     float specular_amount = pow(spec_angle_cos, phong_exponent);
         
-    // Retrieve texture value
-    vec4 pixel = texture(texture_map, uv_interp);
+    // Retrieve texture value from the layer of the node
+    vec4 pixel = texture(texture_map, vec3(uv_interp, layer_interp));
 
     // Use texture in determining fragment colour
-    //gl_FragColor = pixel;
-    //gl_FragColor = (ambient_amount + lambertian_amount)*pixel + specular_amount*specular_color;
-    gl_FragColor = lambertian_amount*pixel + specular_amount*specular_color + ambient_amount*pixel;
+    //frag_color = pixel;
+    //frag_color = (ambient_amount + lambertian_amount)*pixel + specular_amount*specular_color;
+    frag_color = lambertian_amount*pixel + specular_amount*specular_color + ambient_amount*pixel;
 }
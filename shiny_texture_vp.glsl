@@ -1,4 +1,4 @@
-#version 130
+#version 140
 
 // Vertex buffer
 in vec3 vertex;
@@ -6,26 +6,33 @@ in vec3 normal;
 in vec3 color;
 in vec2 uv;
 
-// Uniform (global) buffer
-uniform mat4 world_mat;
-uniform mat4 view_mat;
-uniform mat4 projection_mat;
-uniform mat4 normal_mat;
+// Instance buffer, one entry per drawn node
+in mat4 world_mat;
+in mat4 normal_mat;
+in float layer;
+
+// Per-frame uniform buffer, shared by all programs
+// Keep in sync with FrameBlock in frame_uniforms.h
+layout(std140) uniform FrameBlock {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    vec4 light_position;
+    float timer;
+};
 
 // Attributes forwarded to the fragment shader
 out vec3 position_interp;
 out vec3 normal_interp;
 out vec4 color_interp;
 out vec2 uv_interp;
+flat out float layer_interp;
 out vec3 light_pos;
 
-// Material attributes (constants)
-uniform vec3 light_position = vec3(-0.5, -0.5, 1.5);
-
 
 void main()
 {
-    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+    gl_Position = view_projection_mat * world_mat * vec4(vertex, 1.0);
 
     position_interp = vec3(view_mat * world_mat * vec4(vertex, 1.0));
     
@@ -35,5 +42,7 @@ void main()
 
     uv_interp = uv;
 
-    light_pos = vec3(view_mat * vec4(light_position, 1.0));
+    layer_interp = layer;
+
+    light_pos = vec3(view_mat * light_position);
 }
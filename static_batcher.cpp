@@ -0,0 +1,165 @@
+#include <stack>
+#include <sstream>
+#include <cmath>
+
+#include "static_batcher.h"
+
+namespace game {
+
+bool StaticBatcher::BatchKey::operator<(const BatchKey &other) const {
+
+    if (material != other.material) return material < other.material;
+    if (texture != other.texture) return texture < other.texture;
+    if (sampler != other.sampler) return sampler < other.sampler;
+    if (layer != other.layer) return layer < other.layer;
+    if (pass != other.pass) return pass < other.pass;
+    if (cell_x != other.cell_x) return cell_x < other.cell_x;
+    return cell_z < other.cell_z;
+}
+
+
+StaticBatcher::StaticBatcher(void){
+
+    cell_size_ = 250.0;
+    root_ = NULL;
+}
+
+
+StaticBatcher::~StaticBatcher(){
+}
+
+
+void StaticBatcher::SetCellSize(float size){
+
+    cell_size_ = size;
+}
+
+
+float StaticBatcher::GetCellSize(void) const {
+
+    return cell_size_;
+}
+
+
+size_t StaticBatcher::GetNumBatches(void) const {
+
+    return batches_.size();
+}
+
+
+void StaticBatcher::AppendNode(BatchData &batch, SceneNode *node){
+
+    const std::vector<GLfloat> &vertex = node->GetGeometry()->GetVertexData();
+    const std::vector<GLuint> &face = node->GetGeometry()->GetFaceData();
+
+    // Positions take the full transformation, normals only the rotation,
+    // as when the node is drawn on its own
+    glm::mat4 world = node->GetWorldMatrix();
+    glm::mat3 rotation = glm::mat3(node->GetWorldTransform());
+
+    GLuint base = (GLuint) (batch.vertex.size() / UnpackedVertexSize);
+    for (size_t i = 0; i < vertex.size(); i += UnpackedVertexSize){
+        glm::vec3 position = glm::vec3(world * glm::vec4(vertex[i], vertex[i + 1], vertex[i + 2], 1.0f));
+        glm::vec3 normal = glm::normalize(rotation * glm::vec3(vertex[i + 3], vertex[i + 4], vertex[i + 5]));
+        for (int k = 0; k < 3; k++){
+            batch.vertex.push_back(position[k]);
+        }
+        for (int k = 0; k < 3; k++){
+            batch.vertex.push_back(normal[k]);
+        }
+        // Color and texture coordinates are unchanged
+        batch.vertex.insert(batch.vertex.end(), vertex.begin() + i + ColorOffset, vertex.begin() + i + UnpackedVertexSize);
+    }
+
+    for (size_t i = 0; i < face.size(); i++){
+        batch.face.push_back(base + face[i]);
+    }
+
+    batch.nodes.push_back(node);
+}
+
+
+void StaticBatcher::Build(SceneNode *root, ResourceManager *resman){
+
+    Clear(resman);
+    root_ = root;
+
+    // Place the nodes in the world
+    root->UpdateBounds(glm::mat4(1.0));
+
+    // Group the static nodes by render state and cell
+    std::map<BatchKey, BatchData> batches;
+    std::stack<SceneNode *> stck;
+    stck.push(root);
+    while (stck.size() > 0){
+        SceneNode *current = stck.top();
+        stck.pop();
+        // Hidden nodes might be shown later: leave them alone
+        if (!current->IsVisible()){
+            continue;
+        }
+        const Resource *geometry = current->GetGeometry();
+        if (current->IsStatic() && (geometry->GetType() == Mesh) && !geometry->GetFaceData().empty()){
+            glm::vec3 center = current->GetBoundCenter();
+            BatchKey key;
+            key.material = current->GetMaterialResource();
+            key.texture = current->GetTexture();
+            key.sampler = current->GetSampler();
+            key.layer = current->GetLayer();
+            key.pass = current->GetDrawPass();
+            key.cell_x = (int) std::floor(center.x / cell_size_);
+            key.cell_z = (int) std::floor(center.z / cell_size_);
+            AppendNode(batches[key], current);
+        }
+        for (std::vector<SceneNode *>::const_iterator it = current->children_begin();
+             it != current->children_end(); it++){
+            stck.push(*it);
+        }
+    }
+
+    // Create one mesh and one node per batch
+    for (std::map<BatchKey, BatchData>::iterator it = batches.begin(); it != batches.end(); it++){
+        std::stringstream name;
+        name << "StaticBatch" << batches_.size();
+
+        Resource *geometry = resman->CreateMesh(name.str(), it->second.vertex, it->second.face);
+        SceneNode *batch = new SceneNode(name.str(), geometry, it->first.material);
+        batch->SetTexture(it->first.texture, it->first.sampler, it->first.layer);
+        batch->SetStatic(true);
+        batch->SetDrawPass(it->first.pass);
+        root->AddChild(batch);
+        batches_.push_back(batch);
+
+        for (size_t i = 0; i < it->second.nodes.size(); i++){
+            it->second.nodes[i]->SetBatched(true);
+            sources_.push_back(it->second.nodes[i]);
+        }
+    }
+}
+
+
+void StaticBatcher::Clear(ResourceManager *resman){
+
+    for (size_t i = 0; i < sources_.size(); i++){
+        sources_[i]->SetBatched(false);
+    }
+    sources_.clear();
+
+    for (size_t i = 0; i < batches_.size(); i++){
+        SceneNode *batch = batches_[i];
+        const Resource *geometry = batch->GetGeometry();
+        GLuint vertex_array = geometry->GetVertexArray();
+        GLuint buffers[2] = {geometry->GetArrayBuffer(), geometry->GetElementArrayBuffer()};
+        glDeleteVertexArrays(1, &vertex_array);
+        glDeleteBuffers(2, buffers);
+        resman->RemoveResource(geometry->GetName());
+
+        root_->removeChild(batch);
+        delete batch;
+        // The manager only forgets the resource: the batcher created it
+        delete geometry;
+    }
+    batches_.clear();
+}
+
+} // namespace game
@@ -0,0 +1,71 @@
+#ifndef STATIC_BATCHER_H_
+#define STATIC_BATCHER_H_
+
+#include <vector>
+#include <map>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "resource.h"
+#include "resource_manager.h"
+#include "scene_node.h"
+
+namespace game {
+
+    // Merges the geometry of static nodes sharing a material and texture
+    // layer into a few pre-transformed meshes, one per cell of a grid laid
+    // on the ground, so that they are drawn with a single call per cell
+    // while the cells can still be culled individually
+    class StaticBatcher {
+
+        public:
+            StaticBatcher(void);
+            ~StaticBatcher();
+
+            // Size of the cells grouping nodes, in world units
+            void SetCellSize(float size);
+            float GetCellSize(void) const;
+
+            // Merge the visible static nodes below 'root' and add the
+            // merged meshes as children of 'root'
+            // Batches from a previous call are removed first
+            void Build(SceneNode *root, ResourceManager *resman);
+            // Remove the batches, so that static nodes are drawn on their
+            // own again
+            void Clear(ResourceManager *resman);
+
+            // Number of merged meshes
+            size_t GetNumBatches(void) const;
+
+        private:
+            // Nodes merged in the same mesh
+            struct BatchKey {
+                const Resource *material;
+                GLuint texture;
+                GLuint sampler;
+                int layer;
+                DrawPass pass;
+                int cell_x, cell_z;
+                bool operator<(const BatchKey &other) const;
+            };
+            // Geometry of a batch, in world coordinates
+            struct BatchData {
+                std::vector<GLfloat> vertex;
+                std::vector<GLuint> face;
+                std::vector<SceneNode *> nodes;
+            };
+
+            // Add the geometry of a node to a batch
+            static void AppendNode(BatchData &batch, SceneNode *node);
+
+            float cell_size_;
+            SceneNode *root_; // Node holding the batches
+            std::vector<SceneNode *> batches_; // Nodes drawing the merged meshes
+            std::vector<SceneNode *> sources_; // Nodes merged into the batches
+
+    }; // class StaticBatcher
+
+} // namespace game
+
+#endif // STATIC_BATCHER_H_
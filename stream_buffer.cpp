@@ -0,0 +1,163 @@
+#include <stdexcept>
+#include <string>
+#include <cstring>
+
+#include "stream_buffer.h"
+
+namespace game {
+
+// Frames the CPU may prepare while the GPU draws the previous ones
+const int frames_in_flight_g = 3;
+
+// Time waited at once for a fence, in nanoseconds
+const GLuint64 fence_timeout_g = 1000000000;
+
+
+StreamBuffer::StreamBuffer(void){
+
+    persistent_ = false;
+    buffer_ = 0;
+    mapped_ = NULL;
+    frame_size_ = 0;
+    part_ = 0;
+    used_ = 0;
+}
+
+
+StreamBuffer::~StreamBuffer(){
+}
+
+
+void StreamBuffer::Init(size_t frame_size){
+
+    if (frame_size == 0){
+        throw(std::invalid_argument(std::string("Invalid size for the stream buffer")));
+    }
+    persistent_ = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+    Create(frame_size);
+}
+
+
+void StreamBuffer::Create(size_t frame_size){
+
+    if (buffer_){
+        Retired retired = {buffer_, frames_in_flight_g};
+        retired_.push_back(retired);
+    }
+    for (size_t i = 0; i < fences_.size(); i++){
+        if (fences_[i]){
+            glDeleteSync(fences_[i]);
+        }
+    }
+
+    frame_size_ = frame_size;
+    part_ = 0;
+    used_ = 0;
+    fences_.assign(persistent_ ? frames_in_flight_g : 1, (GLsync) 0);
+
+    // Bound to a target that no vertex array or program reads
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    if (persistent_){
+        // Written by the CPU while the GPU reads other parts; coherent, so
+        // that writes need no explicit flush
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr size = (GLsizeiptr) (frames_in_flight_g*frame_size_);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        mapped_ = (unsigned char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        if (!mapped_){
+            throw(std::runtime_error(std::string("Could not map the stream buffer")));
+        }
+    } else {
+        mapped_ = NULL;
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr) frame_size_, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+void StreamBuffer::BeginFrame(void){
+
+    if (!buffer_){
+        throw(std::runtime_error(std::string("Stream buffer used before Init")));
+    }
+
+    // Buffers replaced a few frames ago are no longer read
+    for (size_t i = 0; i < retired_.size(); ){
+        if (--retired_[i].frames_left <= 0){
+            glDeleteBuffers(1, &retired_[i].buffer);
+            retired_[i] = retired_.back();
+            retired_.pop_back();
+        } else {
+            i++;
+        }
+    }
+
+    if (!persistent_){
+        // Give the old storage to the driver, which frees it once the GPU
+        // is done with it
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr) frame_size_, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        used_ = 0;
+        return;
+    }
+
+    // Mark the end of the commands reading the part of the last frame,
+    // then move to the oldest part
+    if (used_ > 0){
+        fences_[part_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    part_ = (part_ + 1) % frames_in_flight_g;
+    used_ = 0;
+
+    if (fences_[part_]){
+        GLenum status;
+        do {
+            status = glClientWaitSync(fences_[part_], GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout_g);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fences_[part_]);
+        fences_[part_] = 0;
+    }
+}
+
+
+GLintptr StreamBuffer::Upload(const void *data, size_t size, size_t alignment){
+
+    size_t offset = ((used_ + alignment - 1) / alignment) * alignment;
+    if (offset + size > frame_size_){
+        // Grow for the rest of the frame and the next ones; earlier
+        // uploads of the frame stay in the previous buffer
+        size_t frame_size = frame_size_;
+        while (frame_size < size + alignment){
+            frame_size *= 2;
+        }
+        Create(2*frame_size);
+        offset = 0;
+    }
+
+    GLintptr position = (GLintptr) (part_*frame_size_ + offset);
+    if (persistent_){
+        memcpy(mapped_ + position, data, size);
+    } else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, position, (GLsizeiptr) size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    used_ = offset + size;
+    return position;
+}
+
+
+GLuint StreamBuffer::GetBuffer(void) const {
+
+    return buffer_;
+}
+
+
+bool StreamBuffer::IsPersistent(void) const {
+
+    return persistent_;
+}
+
+} // namespace game
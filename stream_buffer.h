@@ -0,0 +1,70 @@
+#ifndef STREAM_BUFFER_H_
+#define STREAM_BUFFER_H_
+
+#include <vector>
+#include <stddef.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace game {
+
+    // Buffer receiving the data that changes every frame, such as the
+    // instance matrices, the frame uniforms and the HUD quads
+    // The buffer is split into one part per frame in flight, and the
+    // systems of a frame take consecutive ranges of the current part
+    // With ARB_buffer_storage the buffer stays mapped, and a fence per part
+    // tells when the GPU is done reading it; otherwise the part is
+    // respecified every frame so that the driver never waits either
+    class StreamBuffer {
+
+        public:
+            StreamBuffer(void);
+            ~StreamBuffer();
+
+            // Create the buffer with room for 'frame_size' bytes per frame
+            // Call once an OpenGL context is available; the buffer grows
+            // if a frame needs more
+            void Init(size_t frame_size = 1 << 20);
+
+            // Move to the part of a new frame, waiting for the GPU only if
+            // it still reads it, i.e. if it is several frames behind
+            void BeginFrame(void);
+
+            // Copy 'size' bytes into the part of the frame, at an offset
+            // multiple of 'alignment', and return that offset
+            // The data stays valid until the same part is used again
+            GLintptr Upload(const void *data, size_t size, size_t alignment = 16);
+
+            // Buffer holding the uploads; may change when the buffer grows,
+            // so get it after uploading
+            GLuint GetBuffer(void) const;
+
+            // Whether the buffer is mapped persistently
+            bool IsPersistent(void) const;
+
+        private:
+            // Create a buffer with the given room per frame, keeping the
+            // previous one until the GPU is done with it
+            void Create(size_t frame_size);
+
+            bool persistent_;
+            GLuint buffer_;
+            unsigned char *mapped_; // Persistent mapping of the buffer
+            size_t frame_size_; // Bytes per frame
+            int part_; // Part of the current frame
+            size_t used_; // Bytes taken in the current part
+            std::vector<GLsync> fences_; // Per part, 0 when not in use
+            // Buffers replaced by a larger one, and the number of frames
+            // before they can be deleted
+            struct Retired {
+                GLuint buffer;
+                int frames_left;
+            };
+            std::vector<Retired> retired_;
+
+    }; // class StreamBuffer
+
+} // namespace game
+
+#endif // STREAM_BUFFER_H_
@@ -0,0 +1,395 @@
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "terrain.h"
+#include "vertex_format.h"
+
+namespace game {
+
+// Size of a tile, in world units, and number of quads along its side at
+// the finest level; each level halves the number of quads
+const float tile_size_g = 256.0f;
+const int tile_quads_g = 32;
+const int num_levels_g = 4;
+const float sample_spacing_g = tile_size_g / tile_quads_g;
+
+// Distance up to which tiles use the finest level; each coarser level
+// reaches twice as far
+const float level_distance_g = 192.0f;
+// Relative change of distance needed to switch to another level, so that
+// tiles near a threshold do not switch back and forth
+const float level_hysteresis_g = 0.1f;
+
+// Tiles are built within this distance of the camera, and removed once
+// their center is past the second one
+const float view_radius_g = 640.0f;
+const float keep_radius_g = view_radius_g + tile_size_g;
+
+// Tiles changing level per frame, after the first
+const int builds_per_frame_g = 2;
+
+// Height of the flat ground around the origin, where the game starts
+const float base_height_g = -15.0f;
+const float flat_radius_g = 100.0f;
+const float flat_blend_g = 150.0f;
+
+// Relief: octaves of value noise, from the widest and highest down
+const float relief_height_g = 10.0f;
+const float relief_scale_g = 320.0f;
+const int relief_octaves_g = 4;
+
+// Repeats of the texture across a tile
+const float texture_repeats_g = 12.0f;
+
+
+// Key of a tile in the map
+static uint64_t TileKey(int x, int z){
+
+    return ((uint64_t) (uint32_t) x << 32) | (uint32_t) z;
+}
+
+
+// Division rounding towards minus infinity
+static int FloorDiv(int a, int b){
+
+    return (a >= 0) ? (a / b) : -((-a + b - 1) / b);
+}
+
+
+// Value in [-1, 1] attached to a point of the lattice of an octave
+static float LatticeValue(int x, int z, int octave){
+
+    uint32_t h = (uint32_t) x*73856093u ^ (uint32_t) z*19349663u ^ (uint32_t) octave*83492791u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return (float) (h & 0xFFFF) / 32767.5f - 1.0f;
+}
+
+
+// Smooth interpolation of the lattice values around a point, in lattice
+// units
+static float ValueNoise(float x, float z, int octave){
+
+    float fx = std::floor(x), fz = std::floor(z);
+    int ix = (int) fx, iz = (int) fz;
+    float tx = x - fx, tz = z - fz;
+    tx = tx*tx*(3.0f - 2.0f*tx);
+    tz = tz*tz*(3.0f - 2.0f*tz);
+    float a = LatticeValue(ix, iz, octave) + tx*(LatticeValue(ix + 1, iz, octave) - LatticeValue(ix, iz, octave));
+    float b = LatticeValue(ix, iz + 1, octave) + tx*(LatticeValue(ix + 1, iz + 1, octave) - LatticeValue(ix, iz + 1, octave));
+    return a + tz*(b - a);
+}
+
+
+// Height of a sample of the finest grid, computed from scratch
+static float ComputeSample(int x, int z){
+
+    float wx = x*sample_spacing_g, wz = z*sample_spacing_g;
+
+    float relief = 0.0f, amplitude = relief_height_g, scale = relief_scale_g;
+    for (int octave = 0; octave < relief_octaves_g; octave++){
+        relief += amplitude*ValueNoise(wx / scale, wz / scale, octave);
+        amplitude *= 0.5f;
+        scale *= 0.5f;
+    }
+
+    // The relief rises smoothly out of the flat area
+    float t = (std::sqrt(wx*wx + wz*wz) - flat_radius_g) / flat_blend_g;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    return base_height_g + relief*t*t*(3.0f - 2.0f*t);
+}
+
+
+Terrain::Terrain(void){
+
+    resman_ = NULL;
+    material_ = NULL;
+    texture_ = NULL;
+    parent_ = NULL;
+    filled_ = false;
+}
+
+
+Terrain::~Terrain(){
+}
+
+
+void Terrain::Init(ResourceManager *resman, const Resource *material, const Resource *texture, SceneNode *parent){
+
+    if (!resman || !material || !parent){
+        throw(std::invalid_argument(std::string("Invalid resources for the terrain")));
+    }
+    resman_ = resman;
+    material_ = material;
+    texture_ = texture;
+    parent_ = parent;
+}
+
+
+void Terrain::Update(glm::vec3 position){
+
+    if (!parent_){
+        throw(std::runtime_error(std::string("Terrain used before Init")));
+    }
+
+    // Tiles in range, with the level they should have
+    struct Work {
+        float distance;
+        Tile *tile;
+        int level;
+        bool operator<(const Work &other) const { return distance < other.distance; }
+    };
+    std::vector<Work> work;
+
+    int center_x = (int) std::floor(position.x / tile_size_g);
+    int center_z = (int) std::floor(position.z / tile_size_g);
+    int range = (int) std::ceil(view_radius_g / tile_size_g);
+    for (int z = center_z - range; z <= center_z + range; z++){
+        for (int x = center_x - range; x <= center_x + range; x++){
+            // Distance to the closest point of the tile
+            float dx = std::max(std::max(x*tile_size_g - position.x, position.x - (x + 1)*tile_size_g), 0.0f);
+            float dz = std::max(std::max(z*tile_size_g - position.z, position.z - (z + 1)*tile_size_g), 0.0f);
+            float distance = std::sqrt(dx*dx + dz*dz);
+            if (distance > view_radius_g){
+                continue;
+            }
+
+            Tile &tile = tiles_[TileKey(x, z)];
+            if (tile.height.empty()){
+                tile.x = x;
+                tile.z = z;
+                tile.node = NULL;
+                tile.geometry = NULL;
+                tile.level = -1;
+                tile.height.resize((tile_quads_g + 1)*(tile_quads_g + 1));
+                for (int j = 0; j <= tile_quads_g; j++){
+                    for (int i = 0; i <= tile_quads_g; i++){
+                        tile.height[j*(tile_quads_g + 1) + i] = ComputeSample(x*tile_quads_g + i, z*tile_quads_g + j);
+                    }
+                }
+            }
+
+            // Only move past a threshold once the distance is clearly
+            // beyond it
+            int level = tile.level;
+            int finer = GetLevel(distance*(1.0f + level_hysteresis_g));
+            int coarser = GetLevel(distance*(1.0f - level_hysteresis_g));
+            if ((level < 0) || (finer < level)){
+                level = finer;
+            } else if (coarser > level){
+                level = coarser;
+            }
+            if (level != tile.level){
+                Work item = {distance, &tile, level};
+                work.push_back(item);
+            }
+        }
+    }
+
+    // New tiles are built right away, as they would leave a hole; others
+    // keep their level until their turn comes
+    std::sort(work.begin(), work.end());
+    int builds = 0;
+    for (size_t i = 0; i < work.size(); i++){
+        if (filled_ && work[i].tile->node && (builds >= builds_per_frame_g)){
+            continue;
+        }
+        if (work[i].tile->node){
+            builds++;
+        }
+        BuildTile(*work[i].tile, work[i].level);
+    }
+    filled_ = true;
+
+    // Remove the tiles left far behind
+    for (std::unordered_map<uint64_t, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ){
+        float dx = (it->second.x + 0.5f)*tile_size_g - position.x;
+        float dz = (it->second.z + 0.5f)*tile_size_g - position.z;
+        if (std::sqrt(dx*dx + dz*dz) > keep_radius_g){
+            FreeTile(it->second);
+            it = tiles_.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+
+float Terrain::GetHeight(float x, float z) const {
+
+    float u = x / sample_spacing_g, v = z / sample_spacing_g;
+    float fu = std::floor(u), fv = std::floor(v);
+    int i = (int) fu, j = (int) fv;
+    float s = u - fu, t = v - fv;
+
+    // Heights of the corners of the quad, all in the tile of its first
+    // corner
+    float h00, h10, h01, h11;
+    int tile_x = FloorDiv(i, tile_quads_g), tile_z = FloorDiv(j, tile_quads_g);
+    std::unordered_map<uint64_t, Tile>::const_iterator it = tiles_.find(TileKey(tile_x, tile_z));
+    if (it != tiles_.end()){
+        const GLfloat *height = &it->second.height[(j - tile_z*tile_quads_g)*(tile_quads_g + 1) + (i - tile_x*tile_quads_g)];
+        h00 = height[0];
+        h10 = height[1];
+        h01 = height[tile_quads_g + 1];
+        h11 = height[tile_quads_g + 2];
+    } else {
+        h00 = ComputeSample(i, j);
+        h10 = ComputeSample(i + 1, j);
+        h01 = ComputeSample(i, j + 1);
+        h11 = ComputeSample(i + 1, j + 1);
+    }
+
+    // Quads are split along the diagonal from (0, 0) to (1, 1)
+    if (s > t){
+        return h00 + s*(h10 - h00) + t*(h11 - h10);
+    } else {
+        return h00 + t*(h01 - h00) + s*(h11 - h01);
+    }
+}
+
+
+float Terrain::GetSample(int x, int z) const {
+
+    int tile_x = FloorDiv(x, tile_quads_g), tile_z = FloorDiv(z, tile_quads_g);
+    std::unordered_map<uint64_t, Tile>::const_iterator it = tiles_.find(TileKey(tile_x, tile_z));
+    if (it == tiles_.end()){
+        return ComputeSample(x, z);
+    }
+    return it->second.height[(z - tile_z*tile_quads_g)*(tile_quads_g + 1) + (x - tile_x*tile_quads_g)];
+}
+
+
+int Terrain::GetLevel(float distance){
+
+    int level = 0;
+    float limit = level_distance_g;
+    while ((level < num_levels_g - 1) && (distance >= limit)){
+        level++;
+        limit *= 2.0f;
+    }
+    return level;
+}
+
+
+void Terrain::BuildTile(Tile &tile, int level){
+
+    int step = 1 << level;
+    int quads = tile_quads_g / step;
+    float spacing = step*sample_spacing_g;
+    int first_x = tile.x*tile_quads_g, first_z = tile.z*tile_quads_g;
+
+    // Grid of vertices, in the space of the tile
+    std::vector<GLfloat> vertex;
+    vertex.reserve(((quads + 1)*(quads + 1) + 4*quads)*UnpackedVertexSize);
+    for (int j = 0; j <= quads; j++){
+        for (int i = 0; i <= quads; i++){
+            int x = first_x + i*step, z = first_z + j*step;
+            // Normal from the slope across the neighbouring samples of the
+            // level, which may lie in other tiles
+            glm::vec3 normal = glm::normalize(glm::vec3(GetSample(x - step, z) - GetSample(x + step, z), 2.0f*spacing, GetSample(x, z - step) - GetSample(x, z + step)));
+            GLfloat attributes[UnpackedVertexSize] = {
+                i*spacing, tile.height[j*step*(tile_quads_g + 1) + i*step], j*spacing,
+                normal.x, normal.y, normal.z,
+                1.0f, 1.0f, 1.0f,
+                texture_repeats_g*i / quads, texture_repeats_g*j / quads
+            };
+            vertex.insert(vertex.end(), attributes, attributes + UnpackedVertexSize);
+        }
+    }
+
+    // Two triangles per quad, facing up and split along the same diagonal
+    // as in GetHeight
+    std::vector<GLuint> face;
+    face.reserve((6*quads*quads + 24*quads));
+    for (int j = 0; j < quads; j++){
+        for (int i = 0; i < quads; i++){
+            GLuint a = j*(quads + 1) + i, b = a + 1, c = a + quads + 1, d = c + 1;
+            GLuint quad[6] = {a, d, b, a, c, d};
+            face.insert(face.end(), quad, quad + 6);
+        }
+    }
+
+    // Skirt hanging from the border, walked around the tile so that it
+    // faces out; deep enough to cover the gap to a coarser neighbour
+    std::vector<GLuint> border;
+    for (int i = 0; i < quads; i++){
+        border.push_back(i);
+    }
+    for (int j = 0; j < quads; j++){
+        border.push_back(j*(quads + 1) + quads);
+    }
+    for (int i = quads; i > 0; i--){
+        border.push_back(quads*(quads + 1) + i);
+    }
+    for (int j = quads; j > 0; j--){
+        border.push_back(j*(quads + 1));
+    }
+    GLuint first_skirt = (GLuint) (vertex.size() / UnpackedVertexSize);
+    float depth = 2.0f*spacing;
+    for (size_t k = 0; k < border.size(); k++){
+        size_t offset = border[k]*UnpackedVertexSize;
+        std::vector<GLfloat> attributes(vertex.begin() + offset, vertex.begin() + offset + UnpackedVertexSize);
+        attributes[PositionOffset + 1] -= depth;
+        vertex.insert(vertex.end(), attributes.begin(), attributes.end());
+    }
+    for (size_t k = 0; k < border.size(); k++){
+        size_t next = (k + 1) % border.size();
+        GLuint e0 = border[k], e1 = border[next];
+        GLuint s0 = first_skirt + (GLuint) k, s1 = first_skirt + (GLuint) next;
+        GLuint quad[6] = {e0, e1, s0, s0, e1, s1};
+        face.insert(face.end(), quad, quad + 6);
+    }
+
+    std::stringstream name;
+    name << "TerrainTile_" << tile.x << "_" << tile.z << "_Level" << level;
+    Resource *geometry = resman_->CreateMesh(name.str(), vertex, face);
+
+    if (tile.node){
+        tile.node->SetGeometry(geometry);
+    } else {
+        std::stringstream node_name;
+        node_name << "TerrainTile_" << tile.x << "_" << tile.z;
+        tile.node = new SceneNode(node_name.str(), geometry, material_, texture_);
+        tile.node->SetPosition(glm::vec3(tile.x*tile_size_g, 0.0f, tile.z*tile_size_g));
+        tile.node->SetDrawPass(GroundPass);
+        parent_->AddChild(tile.node);
+    }
+
+    // The previous mesh is not drawn anymore
+    if (tile.geometry){
+        FreeGeometry(tile.geometry);
+    }
+    tile.geometry = geometry;
+    tile.level = level;
+}
+
+
+void Terrain::FreeTile(Tile &tile){
+
+    if (tile.node){
+        parent_->removeChild(tile.node);
+        delete tile.node;
+        tile.node = NULL;
+    }
+    if (tile.geometry){
+        FreeGeometry(tile.geometry);
+        tile.geometry = NULL;
+    }
+}
+
+
+void Terrain::FreeGeometry(Resource *geometry){
+
+    GLuint vertex_array = geometry->GetVertexArray();
+    GLuint buffers[2] = {geometry->GetArrayBuffer(), geometry->GetElementArrayBuffer()};
+    glDeleteVertexArrays(1, &vertex_array);
+    glDeleteBuffers(2, buffers);
+    resman_->RemoveResource(geometry->GetName());
+    delete geometry;
+}
+
+} // namespace game
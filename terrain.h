@@ -0,0 +1,79 @@
+#ifndef TERRAIN_H_
+#define TERRAIN_H_
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "resource.h"
+#include "resource_manager.h"
+#include "scene_node.h"
+
+namespace game {
+
+    // Ground of the world: a heightfield split into square tiles
+    // Tiles are created when the camera comes within range and removed
+    // once it moves away, so that the world can be of any size
+    // Each tile is drawn at a level of detail chosen by its distance to
+    // the camera, and hangs a skirt from its borders to hide the cracks
+    // between tiles of different levels
+    class Terrain {
+
+        public:
+            Terrain(void);
+            ~Terrain();
+
+            // Draw the tiles with 'material' and 'texture', as children of
+            // 'parent', creating their meshes with 'resman'
+            void Init(ResourceManager *resman, const Resource *material, const Resource *texture, SceneNode *parent);
+
+            // Create the tiles newly in range of 'position', remove those
+            // out of range, and update the level of detail of the others
+            // The first call builds every tile in range; later ones change
+            // the level of a few tiles per frame, nearest first
+            void Update(glm::vec3 position);
+
+            // Height of the ground at the given point, as drawn by the
+            // finest level; a few lookups, cheap enough for every moving
+            // object in every frame
+            float GetHeight(float x, float z) const;
+
+        private:
+            struct Tile {
+                int x, z; // Position in the grid of tiles
+                SceneNode *node; // Node drawing the tile
+                Resource *geometry; // Mesh of the current level
+                int level; // Level of detail of the mesh
+                std::vector<GLfloat> height; // Samples of the finest level
+            };
+
+            // Tiles by position in the grid
+            std::unordered_map<uint64_t, Tile> tiles_;
+            ResourceManager *resman_;
+            const Resource *material_;
+            const Resource *texture_;
+            SceneNode *parent_;
+            bool filled_; // Whether the tiles in range were all built once
+
+            // Height of a sample of the finest grid, read from the tile
+            // holding it when it is built
+            float GetSample(int x, int z) const;
+            // Level of detail of a tile at the given distance
+            static int GetLevel(float distance);
+            // Build the mesh of 'tile' at 'level', and draw it instead of
+            // the previous one
+            void BuildTile(Tile &tile, int level);
+            // Remove the node and mesh of a tile
+            void FreeTile(Tile &tile);
+            // Delete a mesh that is not drawn anymore
+            void FreeGeometry(Resource *geometry);
+
+    }; // class Terrain
+
+} // namespace game
+
+#endif // TERRAIN_H_
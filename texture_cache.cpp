@@ -0,0 +1,380 @@
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <SOIL/SOIL.h>
+
+#include "texture_cache.h"
+#include "hash.h"
+
+namespace game {
+
+// Tag at the start of every cache entry, changed whenever the cooking
+// results change so that older entries are cooked again
+const char cache_magic_g[4] = {'T', 'X', 'C', '1'};
+
+
+TextureCache::TextureCache(void){
+}
+
+
+TextureCache::~TextureCache(){
+}
+
+
+void TextureCache::SetDirectory(const std::string &directory){
+
+    directory_ = directory;
+}
+
+
+const std::string &TextureCache::GetDirectory(void) const {
+
+    return directory_;
+}
+
+
+size_t TextureCache::GetLevelSize(GLenum format, int width, int height){
+
+    // Blocks of 4x4 pixels, partial blocks included
+    size_t block_size = (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+    return ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+
+void TextureCache::Get(const std::string &filename, int width, int height, bool force_alpha, CompressedImage &image){
+
+    // Name the entry after the source and the cooking parameters
+    std::ifstream source(filename.c_str(), std::ios::binary);
+    if (source.fail()){
+        throw(std::ios_base::failure(std::string("Error opening file ")+filename));
+    }
+    std::vector<char> content((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    source.close();
+
+    uint64_t hash = HashBytes(content.empty() ? NULL : &content[0], content.size());
+    int params[3] = {width, height, force_alpha ? 1 : 0};
+    hash = HashBytes(params, sizeof(params), hash);
+
+    std::string path;
+    if (!directory_.empty()){
+        std::stringstream ss;
+        ss << directory_ << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".txc";
+        path = ss.str();
+        if (ReadEntry(path, image)){
+            return;
+        }
+    }
+
+    // Cook the image
+    int image_width, image_height, channels;
+    unsigned char *pixels = SOIL_load_image(filename.c_str(), &image_width, &image_height, &channels, SOIL_LOAD_RGBA);
+    if (!pixels){
+        throw(std::ios_base::failure(std::string("Error loading texture ")+filename+std::string(": ")+std::string(SOIL_last_result())));
+    }
+    if ((width <= 0) || (height <= 0) || ((width == image_width) && (height == image_height))){
+        Compress(pixels, image_width, image_height, force_alpha, image);
+    } else {
+        std::vector<unsigned char> resampled(4*width*height);
+        Resample(pixels, image_width, image_height, &resampled[0], width, height);
+        Compress(&resampled[0], width, height, force_alpha, image);
+    }
+    SOIL_free_image_data(pixels);
+
+    if (!path.empty()){
+        WriteEntry(path, image);
+    }
+}
+
+
+bool TextureCache::ReadEntry(const std::string &path, CompressedImage &image) const {
+
+    std::ifstream f(path.c_str(), std::ios::binary);
+    if (f.fail()){
+        return false;
+    }
+
+    char magic[4];
+    uint32_t format, num_levels;
+    int32_t width, height;
+    f.read(magic, 4);
+    f.read((char *) &format, sizeof(format));
+    f.read((char *) &width, sizeof(width));
+    f.read((char *) &height, sizeof(height));
+    f.read((char *) &num_levels, sizeof(num_levels));
+    if (f.fail() || !std::equal(magic, magic + 4, cache_magic_g) || (width <= 0) || (height <= 0) || (num_levels > 32)){
+        return false;
+    }
+
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.levels.resize(num_levels);
+    for (uint32_t i = 0; i < num_levels; i++){
+        uint32_t size;
+        f.read((char *) &size, sizeof(size));
+        if (f.fail() || (size != GetLevelSize(format, std::max(width >> i, 1), std::max(height >> i, 1)))){
+            return false;
+        }
+        image.levels[i].resize(size);
+        f.read((char *) &image.levels[i][0], size);
+    }
+
+    return !f.fail();
+}
+
+
+void TextureCache::WriteEntry(const std::string &path, const CompressedImage &image) const {
+
+    // The cache only saves time: an entry that cannot be written is cooked
+    // again on the next run
+    std::ofstream f(path.c_str(), std::ios::binary);
+    if (f.fail()){
+        return;
+    }
+
+    uint32_t format = image.format;
+    int32_t width = image.width, height = image.height;
+    uint32_t num_levels = (uint32_t) image.levels.size();
+    f.write(cache_magic_g, 4);
+    f.write((const char *) &format, sizeof(format));
+    f.write((const char *) &width, sizeof(width));
+    f.write((const char *) &height, sizeof(height));
+    f.write((const char *) &num_levels, sizeof(num_levels));
+    for (uint32_t i = 0; i < num_levels; i++){
+        uint32_t size = (uint32_t) image.levels[i].size();
+        f.write((const char *) &size, sizeof(size));
+        f.write((const char *) &image.levels[i][0], size);
+    }
+}
+
+
+void TextureCache::Resample(const unsigned char *src, int src_width, int src_height, unsigned char *dst, int dst_width, int dst_height){
+
+    bool shrink = (src_width > dst_width) || (src_height > dst_height);
+    float scale_x = (float) src_width / dst_width;
+    float scale_y = (float) src_height / dst_height;
+
+    for (int y = 0; y < dst_height; y++){
+        for (int x = 0; x < dst_width; x++){
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            if (shrink){
+                // Box filter over the source pixels covered by the target
+                int x0 = (int) (x*scale_x), x1 = std::max((int) ((x + 1)*scale_x), x0 + 1);
+                int y0 = (int) (y*scale_y), y1 = std::max((int) ((y + 1)*scale_y), y0 + 1);
+                x1 = std::min(x1, src_width);
+                y1 = std::min(y1, src_height);
+                for (int sy = y0; sy < y1; sy++){
+                    for (int sx = x0; sx < x1; sx++){
+                        const unsigned char *p = &src[4*(sy*src_width + sx)];
+                        for (int c = 0; c < 4; c++){
+                            sum[c] += p[c];
+                        }
+                    }
+                }
+                float weight = 1.0f / ((x1 - x0)*(y1 - y0));
+                for (int c = 0; c < 4; c++){
+                    sum[c] *= weight;
+                }
+            } else {
+                // Bilinear interpolation between pixel centers
+                float fx = std::min(std::max((x + 0.5f)*scale_x - 0.5f, 0.0f), (float) (src_width - 1));
+                float fy = std::min(std::max((y + 0.5f)*scale_y - 0.5f, 0.0f), (float) (src_height - 1));
+                int x0 = (int) fx, x1 = std::min(x0 + 1, src_width - 1);
+                int y0 = (int) fy, y1 = std::min(y0 + 1, src_height - 1);
+                float tx = fx - x0, ty = fy - y0;
+                for (int c = 0; c < 4; c++){
+                    float top = src[4*(y0*src_width + x0) + c]*(1.0f - tx) + src[4*(y0*src_width + x1) + c]*tx;
+                    float bottom = src[4*(y1*src_width + x0) + c]*(1.0f - tx) + src[4*(y1*src_width + x1) + c]*tx;
+                    sum[c] = top*(1.0f - ty) + bottom*ty;
+                }
+            }
+            unsigned char *q = &dst[4*(y*dst_width + x)];
+            for (int c = 0; c < 4; c++){
+                q[c] = (unsigned char) std::min(sum[c] + 0.5f, 255.0f);
+            }
+        }
+    }
+}
+
+
+// Pack an RGB color in 5:6:5 bits, and expand it back to 8 bits per channel
+static uint16_t PackColor(const int *color){
+
+    return (uint16_t) (((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+
+static void UnpackColor(uint16_t packed, int *color){
+
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+
+// Encode the colors of a block of 16 RGBA pixels in DXT1 format (8 bytes)
+// The end points are the corners of the bounding box of the colors, moved
+// slightly inwards
+static void EncodeColorBlock(const unsigned char block[16][4], unsigned char *out){
+
+    int min_color[3] = {255, 255, 255}, max_color[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++){
+        for (int c = 0; c < 3; c++){
+            min_color[c] = std::min(min_color[c], (int) block[i][c]);
+            max_color[c] = std::max(max_color[c], (int) block[i][c]);
+        }
+    }
+    for (int c = 0; c < 3; c++){
+        int inset = (max_color[c] - min_color[c]) >> 4;
+        min_color[c] += inset;
+        max_color[c] -= inset;
+    }
+
+    // The first end point must be larger for the four-color mode
+    uint16_t c0 = PackColor(max_color), c1 = PackColor(min_color);
+    if (c0 < c1){
+        std::swap(c0, c1);
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1){
+        int palette[4][3];
+        UnpackColor(c0, palette[0]);
+        UnpackColor(c1, palette[1]);
+        for (int c = 0; c < 3; c++){
+            palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++){
+            int best = 0, best_distance = 0x7fffffff;
+            for (int j = 0; j < 4; j++){
+                int distance = 0;
+                for (int c = 0; c < 3; c++){
+                    int d = block[i][c] - palette[j][c];
+                    distance += d*d;
+                }
+                if (distance < best_distance){
+                    best = j;
+                    best_distance = distance;
+                }
+            }
+            indices |= (uint32_t) best << (2*i);
+        }
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++){
+        out[4 + i] = (indices >> (8*i)) & 0xff;
+    }
+}
+
+
+// Encode the alpha of a block of 16 RGBA pixels in DXT5 format (8 bytes)
+static void EncodeAlphaBlock(const unsigned char block[16][4], unsigned char *out){
+
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++){
+        a0 = std::max(a0, (int) block[i][3]);
+        a1 = std::min(a1, (int) block[i][3]);
+    }
+
+    // Eight interpolated values between the end points, the largest first
+    uint64_t indices = 0;
+    if (a0 != a1){
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (int j = 1; j < 7; j++){
+            palette[j + 1] = ((7 - j)*a0 + j*a1) / 7;
+        }
+        for (int i = 0; i < 16; i++){
+            int best = 0, best_distance = 256;
+            for (int j = 0; j < 8; j++){
+                int distance = std::abs(block[i][3] - palette[j]);
+                if (distance < best_distance){
+                    best = j;
+                    best_distance = distance;
+                }
+            }
+            indices |= (uint64_t) best << (3*i);
+        }
+    }
+
+    out[0] = (unsigned char) a0;
+    out[1] = (unsigned char) a1;
+    for (int i = 0; i < 6; i++){
+        out[2 + i] = (indices >> (8*i)) & 0xff;
+    }
+}
+
+
+void TextureCache::Compress(const unsigned char *rgba, int width, int height, bool force_alpha, CompressedImage &image){
+
+    // Images without transparency only need colors
+    bool opaque = !force_alpha;
+    for (int i = 0; opaque && (i < width*height); i++){
+        opaque = (rgba[4*i + 3] == 255);
+    }
+    image.format = opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    image.width = width;
+    image.height = height;
+    image.levels.clear();
+
+    std::vector<unsigned char> level(rgba, rgba + 4*width*height);
+    int level_width = width, level_height = height;
+    while (true){
+        // Encode the blocks of the level; blocks crossing the border
+        // repeat the last row and column
+        std::vector<unsigned char> blocks(GetLevelSize(image.format, level_width, level_height));
+        unsigned char *out = &blocks[0];
+        for (int by = 0; by < level_height; by += 4){
+            for (int bx = 0; bx < level_width; bx += 4){
+                unsigned char block[16][4];
+                for (int i = 0; i < 16; i++){
+                    int x = std::min(bx + (i & 3), level_width - 1);
+                    int y = std::min(by + (i >> 2), level_height - 1);
+                    std::copy(&level[4*(y*level_width + x)], &level[4*(y*level_width + x)] + 4, block[i]);
+                }
+                if (!opaque){
+                    EncodeAlphaBlock(block, out);
+                    out += 8;
+                }
+                EncodeColorBlock(block, out);
+                out += 8;
+            }
+        }
+        image.levels.push_back(blocks);
+
+        if ((level_width == 1) && (level_height == 1)){
+            break;
+        }
+
+        // Next level: average 2x2 pixels, as glGenerateMipmap does
+        int next_width = std::max(level_width / 2, 1), next_height = std::max(level_height / 2, 1);
+        std::vector<unsigned char> next(4*next_width*next_height);
+        for (int y = 0; y < next_height; y++){
+            int y0 = std::min(2*y, level_height - 1), y1 = std::min(2*y + 1, level_height - 1);
+            for (int x = 0; x < next_width; x++){
+                int x0 = std::min(2*x, level_width - 1), x1 = std::min(2*x + 1, level_width - 1);
+                for (int c = 0; c < 4; c++){
+                    int sum = level[4*(y0*level_width + x0) + c] + level[4*(y0*level_width + x1) + c] +
+                              level[4*(y1*level_width + x0) + c] + level[4*(y1*level_width + x1) + c];
+                    next[4*(y*next_width + x) + c] = (unsigned char) ((sum + 2) / 4);
+                }
+            }
+        }
+        level.swap(next);
+        level_width = next_width;
+        level_height = next_height;
+    }
+}
+
+} // namespace game
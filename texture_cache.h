@@ -0,0 +1,66 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace game {
+
+    // Image cooked for upload: block-compressed pixels with the full chain
+    // of mipmaps
+    struct CompressedImage {
+        GLenum format; // DXT1 (BC1) for opaque images, DXT5 (BC3) otherwise
+        int width, height; // Size of the first level
+        std::vector<std::vector<unsigned char> > levels; // Blocks of each
+                                                         // level, finest first
+    };
+
+    // Converts image files to block-compressed textures with precomputed
+    // mipmaps, and keeps the result in a directory so that later runs
+    // upload the blocks without decoding the source again
+    // Entries are named after a hash of the source file and of the cooking
+    // parameters, so that editing an image cooks it again
+    class TextureCache {
+
+        public:
+            TextureCache(void);
+            ~TextureCache();
+
+            // Directory holding the cooked textures; nothing is stored
+            // while it is empty
+            void SetDirectory(const std::string &directory);
+            const std::string &GetDirectory(void) const;
+
+            // Get the cooked version of an image file resized to 'width' x
+            // 'height' (the size of the file if 0), cooking it if the cache
+            // has no entry for it
+            // Opaque images use DXT1 unless 'force_alpha' is set
+            void Get(const std::string &filename, int width, int height, bool force_alpha, CompressedImage &image);
+
+            // Compress an RGBA image and its mipmaps
+            static void Compress(const unsigned char *rgba, int width, int height, bool force_alpha, CompressedImage &image);
+
+            // Resample an RGBA image: pixels are averaged over their
+            // footprint when shrinking and interpolated when enlarging
+            static void Resample(const unsigned char *src, int src_width, int src_height, unsigned char *dst, int dst_width, int dst_height);
+
+            // Number of bytes of a level of the given size
+            static size_t GetLevelSize(GLenum format, int width, int height);
+
+        private:
+            // Read and write cache entries; a missing or stale entry is
+            // not an error
+            bool ReadEntry(const std::string &path, CompressedImage &image) const;
+            void WriteEntry(const std::string &path, const CompressedImage &image) const;
+
+            std::string directory_;
+
+    }; // class TextureCache
+
+} // namespace game
+
+#endif // TEXTURE_CACHE_H_
@@ -0,0 +1,101 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+#include "vertex_format.h"
+
+namespace game {
+
+// Convert a float to a half float, rounding to the nearest value
+static GLushort FloatToHalf(float value){
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int exponent = (int) float_exponent - 127 + 15;
+
+    // Infinity and not-a-number keep their kind
+    if (float_exponent == 0xFF){
+        return (GLushort) (sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    // Too large: infinity
+    if (exponent >= 31){
+        return (GLushort) (sign | 0x7C00);
+    }
+    // Too small for a normal half float: denormal, or zero
+    if (exponent <= 0){
+        if (exponent < -10){
+            return (GLushort) sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1){
+            half++;
+        }
+        return (GLushort) (sign | half);
+    }
+
+    // Rounding up may carry into the exponent, which gives the right value
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000){
+        half++;
+    }
+    return (GLushort) half;
+}
+
+
+// Quantize a value in [-1, 1] to a signed integer of 'bits' bits
+static uint32_t ToSnorm(float value, int bits){
+
+    float max_value = (float) ((1 << (bits - 1)) - 1);
+    int quantized = (int) std::floor(std::min(std::max(value, -1.0f), 1.0f)*max_value + 0.5f);
+    return (uint32_t) quantized & ((1u << bits) - 1);
+}
+
+
+void Float3Encoding::Pack(const GLfloat *value, unsigned char *out){
+
+    memcpy(out, value, bytes);
+}
+
+
+void Float2Encoding::Pack(const GLfloat *value, unsigned char *out){
+
+    memcpy(out, value, bytes);
+}
+
+
+void Half2Encoding::Pack(const GLfloat *value, unsigned char *out){
+
+    GLushort half[2] = {FloatToHalf(value[0]), FloatToHalf(value[1])};
+    memcpy(out, half, bytes);
+}
+
+
+void Snorm1010102Encoding::Pack(const GLfloat *value, unsigned char *out){
+
+    // First component in the lowest bits
+    GLuint packed = ToSnorm(value[0], 10) | (ToSnorm(value[1], 10) << 10) | (ToSnorm(value[2], 10) << 20);
+    memcpy(out, &packed, bytes);
+}
+
+
+void Unorm8x4Encoding::Pack(const GLfloat *value, unsigned char *out){
+
+    for (int i = 0; i < 3; i++){
+        out[i] = (unsigned char) std::floor(std::min(std::max(value[i], 0.0f), 1.0f)*255.0f + 0.5f);
+    }
+    out[3] = 255;
+}
+
+
+bool PackedVertexFormatsSupported(void){
+
+    return GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev;
+}
+
+} // namespace game
@@ -0,0 +1,178 @@
+#ifndef VERTEX_FORMAT_H_
+#define VERTEX_FORMAT_H_
+
+#include <stddef.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "resource.h"
+
+namespace game {
+
+    // Meshes are built on the CPU with 11 floats per vertex, then packed
+    // into the vertex format of their buffer when uploaded
+    // Offsets of the attributes in an unpacked vertex, and its size
+    typedef enum UnpackedVertex { PositionOffset = 0, NormalOffset = 3, ColorOffset = 6, UVOffset = 9, UnpackedVertexSize = 11 } UnpackedVertexOffset;
+
+    // Ways of storing an attribute in a vertex buffer
+    // Each one converts the floats of an unpacked vertex to its storage,
+    // and tells OpenGL how to read them back
+
+    // Three floats
+    struct Float3Encoding {
+        static constexpr GLint components = 3;
+        static constexpr GLenum type = GL_FLOAT;
+        static constexpr GLboolean normalized = GL_FALSE;
+        static constexpr GLsizei bytes = 3*sizeof(GLfloat);
+        static void Pack(const GLfloat *value, unsigned char *out);
+    };
+
+    // Two floats
+    struct Float2Encoding {
+        static constexpr GLint components = 2;
+        static constexpr GLenum type = GL_FLOAT;
+        static constexpr GLboolean normalized = GL_FALSE;
+        static constexpr GLsizei bytes = 2*sizeof(GLfloat);
+        static void Pack(const GLfloat *value, unsigned char *out);
+    };
+
+    // Two half floats, e.g. for texture coordinates: exact for integers
+    // up to 2048, and about three decimal digits otherwise
+    struct Half2Encoding {
+        static constexpr GLint components = 2;
+        static constexpr GLenum type = GL_HALF_FLOAT;
+        static constexpr GLboolean normalized = GL_FALSE;
+        static constexpr GLsizei bytes = 2*sizeof(GLushort);
+        static void Pack(const GLfloat *value, unsigned char *out);
+    };
+
+    // Three values in [-1, 1] with 10 bits each, e.g. for unit normals;
+    // the shader reads 0 as fourth component
+    struct Snorm1010102Encoding {
+        static constexpr GLint components = 4;
+        static constexpr GLenum type = GL_INT_2_10_10_10_REV;
+        static constexpr GLboolean normalized = GL_TRUE;
+        static constexpr GLsizei bytes = sizeof(GLuint);
+        static void Pack(const GLfloat *value, unsigned char *out);
+    };
+
+    // Three values in [0, 1] with 8 bits each, e.g. for colors; the
+    // shader reads 1 as fourth component
+    struct Unorm8x4Encoding {
+        static constexpr GLint components = 4;
+        static constexpr GLenum type = GL_UNSIGNED_BYTE;
+        static constexpr GLboolean normalized = GL_TRUE;
+        static constexpr GLsizei bytes = 4*sizeof(GLubyte);
+        static void Pack(const GLfloat *value, unsigned char *out);
+    };
+
+    // Attribute of a vertex format: shader location, offset of its
+    // values in an unpacked vertex, and encoding in the buffer
+    template <AttributeLocation Location, UnpackedVertexOffset Offset, typename Encoding>
+    struct VertexElement {
+        static constexpr GLsizei bytes = Encoding::bytes;
+
+        static void Pack(const GLfloat *vertex, unsigned char *out){
+            Encoding::Pack(vertex + Offset, out);
+        }
+
+        static void SetupAttribute(GLsizei stride, size_t offset){
+            glVertexAttribPointer(Location, Encoding::components, Encoding::type, Encoding::normalized, stride, (void *) offset);
+            glEnableVertexAttribArray(Location);
+        }
+    };
+
+    // Vertex format made of elements stored one after the other
+    // Attributes of the shaders missing from the format read their
+    // default value, e.g. a black color
+    template <typename... Elements>
+    struct VertexFormat;
+
+    template <>
+    struct VertexFormat<> {
+        static constexpr GLsizei stride = 0;
+        static void PackElements(const GLfloat *, unsigned char *){}
+        static void SetupElements(GLsizei, size_t){}
+    };
+
+    template <typename First, typename... Rest>
+    struct VertexFormat<First, Rest...> {
+        // Bytes per vertex in the buffer
+        static constexpr GLsizei stride = First::bytes + VertexFormat<Rest...>::stride;
+
+        // Pack one unpacked vertex into 'stride' bytes of 'out'
+        static void Pack(const GLfloat *vertex, unsigned char *out){
+            PackElements(vertex, out);
+        }
+
+        // Point the attributes at the array buffer bound, and enable them
+        // Records the format in the vertex array bound
+        static void SetupAttributes(void){
+            SetupElements(stride, 0);
+        }
+
+        static void PackElements(const GLfloat *vertex, unsigned char *out){
+            First::Pack(vertex, out);
+            VertexFormat<Rest...>::PackElements(vertex, out + First::bytes);
+        }
+
+        static void SetupElements(GLsizei format_stride, size_t offset){
+            First::SetupAttribute(format_stride, offset);
+            VertexFormat<Rest...>::SetupElements(format_stride, offset + First::bytes);
+        }
+    };
+
+    // Layout of the unpacked vertices, 44 bytes
+    typedef VertexFormat<VertexElement<VertexAttribute, PositionOffset, Float3Encoding>,
+                         VertexElement<NormalAttribute, NormalOffset, Float3Encoding>,
+                         VertexElement<ColorAttribute, ColorOffset, Float3Encoding>,
+                         VertexElement<UVAttribute, UVOffset, Float2Encoding> > FloatVertexFormat;
+
+    // Packed normals, colors and texture coordinates, 24 bytes
+    typedef VertexFormat<VertexElement<VertexAttribute, PositionOffset, Float3Encoding>,
+                         VertexElement<NormalAttribute, NormalOffset, Snorm1010102Encoding>,
+                         VertexElement<ColorAttribute, ColorOffset, Unorm8x4Encoding>,
+                         VertexElement<UVAttribute, UVOffset, Half2Encoding> > PackedVertexFormat;
+
+    // Packed normals and texture coordinates without colors, 20 bytes,
+    // for shaders that do not read the vertex color
+    typedef VertexFormat<VertexElement<VertexAttribute, PositionOffset, Float3Encoding>,
+                         VertexElement<NormalAttribute, NormalOffset, Snorm1010102Encoding>,
+                         VertexElement<UVAttribute, UVOffset, Half2Encoding> > CompactVertexFormat;
+
+    // Vertices of baked prefabs, which carry the part of the prefab and
+    // the texture layer of the vertex in place of the color (see
+    // PrefabMesh), 40 bytes
+    typedef VertexFormat<VertexElement<VertexAttribute, PositionOffset, Float3Encoding>,
+                         VertexElement<NormalAttribute, NormalOffset, Float3Encoding>,
+                         VertexElement<PartAttribute, ColorOffset, Float2Encoding>,
+                         VertexElement<UVAttribute, UVOffset, Float2Encoding> > FloatPartVertexFormat;
+
+    // Same with packed normals, and half floats for the texture
+    // coordinates, part and layer, which are small integers, 24 bytes
+    typedef VertexFormat<VertexElement<VertexAttribute, PositionOffset, Float3Encoding>,
+                         VertexElement<NormalAttribute, NormalOffset, Snorm1010102Encoding>,
+                         VertexElement<PartAttribute, ColorOffset, Half2Encoding>,
+                         VertexElement<UVAttribute, UVOffset, Half2Encoding> > PackedPartVertexFormat;
+
+    // Vertex format chosen at run time, e.g. by the resource manager
+    struct VertexLayout {
+        GLsizei stride; // Bytes per vertex
+        void (*pack)(const GLfloat *vertex, unsigned char *out);
+        void (*setup)(void);
+    };
+
+    // Run-time view of one of the formats above
+    template <typename Format>
+    const VertexLayout *GetVertexLayout(void){
+        static const VertexLayout layout = {Format::stride, &Format::Pack, &Format::SetupAttributes};
+        return &layout;
+    }
+
+    // Whether the driver reads the packed encodings (OpenGL 3.3)
+    bool PackedVertexFormatsSupported(void);
+
+} // namespace game
+
+#endif // VERTEX_FORMAT_H_
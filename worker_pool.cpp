@@ -0,0 +1,128 @@
+#include "worker_pool.h"
+
+namespace game {
+
+WorkerPool::WorkerPool(size_t num_workers){
+
+    task_ = NULL;
+    num_tasks_ = 0;
+    next_task_ = 0;
+    num_busy_ = 0;
+    loop_ = 0;
+    quit_ = false;
+
+    // Thread 0 is the one calling Run
+    for (size_t i = 0; i < num_workers; i++){
+        workers_.push_back(std::thread(&WorkerPool::WorkerLoop, this, i + 1));
+    }
+}
+
+
+WorkerPool::~WorkerPool(){
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    start_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++){
+        workers_[i].join();
+    }
+}
+
+
+size_t WorkerPool::GetNumThreads(void) const {
+
+    return workers_.size() + 1;
+}
+
+
+size_t WorkerPool::GetDefaultNumWorkers(void){
+
+    // The number of hardware threads is 0 when unknown
+    unsigned hardware = std::thread::hardware_concurrency();
+    return (hardware > 1) ? (hardware - 1) : 0;
+}
+
+
+void WorkerPool::Run(size_t num_tasks, const Task &task){
+
+    // Waking up the workers is not worth it for a single task
+    if (workers_.empty() || (num_tasks <= 1)){
+        for (size_t i = 0; i < num_tasks; i++){
+            task(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        num_tasks_ = num_tasks;
+        next_task_ = 0;
+        num_busy_ = workers_.size();
+        error_ = std::exception_ptr();
+        loop_++;
+    }
+    start_.notify_all();
+
+    RunTasks(0);
+
+    // Every worker takes part in every loop, so that none can still be
+    // reading the task once Run returns
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (num_busy_ > 0){
+        done_.wait(lock);
+    }
+    task_ = NULL;
+    if (error_){
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+
+void WorkerPool::WorkerLoop(size_t thread){
+
+    unsigned loop = 0;
+    while (true){
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!quit_ && (loop_ == loop)){
+                start_.wait(lock);
+            }
+            if (quit_){
+                return;
+            }
+            loop = loop_;
+        }
+
+        RunTasks(thread);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        num_busy_--;
+        if (num_busy_ == 0){
+            done_.notify_one();
+        }
+    }
+}
+
+
+void WorkerPool::RunTasks(size_t thread){
+
+    size_t i;
+    while ((i = next_task_++) < num_tasks_){
+        try {
+            (*task_)(i, thread);
+        }
+        catch (...){
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_){
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+} // namespace game
@@ -0,0 +1,61 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+namespace game {
+
+    // Fixed set of threads running the tasks of a parallel loop
+    // The thread calling Run takes part in the loop, so that a pool
+    // without workers simply runs every task in order
+    class WorkerPool {
+
+        public:
+            // Function run for each task, receiving the index of the task
+            // and the index of the thread running it, in [0, GetNumThreads())
+            typedef std::function<void (size_t task, size_t thread)> Task;
+
+            // Start 'num_workers' threads besides the calling thread
+            WorkerPool(size_t num_workers);
+            ~WorkerPool();
+
+            // Number of threads taking part in Run, including the caller
+            size_t GetNumThreads(void) const;
+
+            // Run 'task' for every index in [0, num_tasks) and wait until
+            // all are done
+            // An exception thrown by a task is thrown again here
+            void Run(size_t num_tasks, const Task &task);
+
+            // One worker per hardware thread, the caller excluded
+            static size_t GetDefaultNumWorkers(void);
+
+        private:
+            // Wait for loops to run until the pool is destroyed
+            void WorkerLoop(size_t thread);
+            // Take tasks of the current loop until none is left
+            void RunTasks(size_t thread);
+
+            std::vector<std::thread> workers_;
+            std::mutex mutex_;
+            std::condition_variable start_; // Signals a new loop, or quitting
+            std::condition_variable done_; // Signals the end of a loop
+            const Task *task_; // Task of the current loop
+            size_t num_tasks_;
+            std::atomic<size_t> next_task_; // Next task to be taken
+            size_t num_busy_; // Workers still running the current loop
+            unsigned loop_; // Number of loops started, to wake up workers
+            bool quit_;
+            std::exception_ptr error_; // First exception thrown by a task
+
+    }; // class WorkerPool
+
+} // namespace game
+
+#endif // WORKER_POOL_H_